@@ -16,6 +16,18 @@ static uint8	region_map[6][6] =
 	{ 0,    0,    0,    0,    0, 0x10 }
 };
 
+// The clip windows last worked out for each combination of window registers,
+// so that HDMA-driven window effects find the same regions again next frame.
+#define CLIP_CACHE_SIZE	256
+
+static struct
+{
+	bool8	Valid;
+	uint32	Windows;
+	uint64	Flags;
+	struct ClipData	Clip[2][6];
+}	ClipCache[CLIP_CACHE_SIZE];
+
 static inline uint8 CalcWindowMask (int, uint8, uint8);
 static inline void StoreWindowRegions (uint8, struct ClipData *, int, int16 *, uint8 *, bool8, bool8 s = FALSE);
 
@@ -106,6 +118,24 @@ void S9xComputeClipWindows (void)
 	int		n_regions = 1;
 	int		i, j;
 
+	// Everything the regions depend on: the window positions, each layer's
+	// window settings, which layers are windowed, and the color window.
+	uint32	Windows = PPU.Window1Left | (PPU.Window1Right << 8) | (PPU.Window2Left << 16) | (PPU.Window2Right << 24);
+	uint64	Flags = (Memory.FillRAM[0x212e] & 0x1f) | ((Memory.FillRAM[0x212f] & 0x1f) << 5) | ((Memory.FillRAM[0x2130] & 0xf0) << 6) |
+		((uint64) (Settings.DisableGraphicWindows ? 1 : 0) << 14);
+
+	for (i = 0; i < 6; i++)
+		Flags |= (uint64) ((PPU.ClipWindowOverlapLogic[i] & 3) | (!!PPU.ClipWindow1Enable[i] << 2) | (!!PPU.ClipWindow2Enable[i] << 3) |
+			(!!PPU.ClipWindow1Inside[i] << 4) | (!!PPU.ClipWindow2Inside[i] << 5)) << (i * 6 + 15);
+
+	uint32	hash = (((uint32) (Windows ^ Flags ^ (Flags >> 32)) * 0x9e3779b1u) >> 24) & (CLIP_CACHE_SIZE - 1);
+
+	if (ClipCache[hash].Valid && ClipCache[hash].Windows == Windows && ClipCache[hash].Flags == Flags)
+	{
+		memcpy(IPPU.Clip, ClipCache[hash].Clip, sizeof(IPPU.Clip));
+		return;
+	}
+
 	// Calculate window regions. We have at most 5 regions, because we have 6 control points
 	// (screen edges, window 1 left & right, and window 2 left & right).
 
@@ -231,4 +261,9 @@ void S9xComputeClipWindows (void)
 				StoreWindowRegions(0, &IPPU.Clip[sub][j], n_regions, windows, drawing_modes, sub);
 		}
 	}
+
+	ClipCache[hash].Valid = TRUE;
+	ClipCache[hash].Windows = Windows;
+	ClipCache[hash].Flags = Flags;
+	memcpy(ClipCache[hash].Clip, IPPU.Clip, sizeof(IPPU.Clip));
 }
@@ -23,7 +23,10 @@ extern SPC7110	s7emu;
 static uint8	sdd1_decode_buffer[0x10000];
 
 static inline bool8 addCyclesInDMA (uint8);
+static inline int32 bytesBeforeEvent (uint8, int32);
 static inline bool8 HDMAReadLineCount (int);
+static void DMAWordsToVRAM (const uint8 *, int32);
+static void DMABytesToWRAM (const uint8 *, int32);
 
 
 static inline bool8 addCyclesInDMA (uint8 dma_channel)
@@ -49,6 +52,64 @@ static inline bool8 addCyclesInDMA (uint8 dma_channel)
 	return (TRUE);
 }
 
+static inline int32 bytesBeforeEvent (uint8 dma_channel, int32 count)
+{
+	// How many of the next count bytes can have their 8 cycles added without
+	// reaching CPU.NextEvent, so that no H-event, HDMA or IRQ comes between
+	// them and addCyclesInDMA() would only have added cycles.
+	if (CPU.HDMARanInDMA & (1 << dma_channel))
+		return (0);
+
+	int32	n = CPU.NextEvent - CPU.Cycles - 1;
+	if (n < SLOW_ONE_CYCLE)
+		return (0);
+
+	n /= SLOW_ONE_CYCLE;
+	return (n < count ? n : count);
+}
+
+static void DMAWordsToVRAM (const uint8 *src, int32 bytes)
+{
+	// Low and high bytes with VMAIN stepping one word after the high byte
+	// fill VRAM in order, wrapping at 64KB.
+	uint32	address = (PPU.VMA.Address << 1) & 0xffff;
+
+	PPU.VMA.Address += bytes >> 1;
+	IPPU.VRAMChanged = TRUE;
+
+	while (bytes > 0)
+	{
+		int32	n = 0x10000 - address;
+		if (n > bytes)
+			n = bytes;
+
+		memcpy(Memory.VRAM + address, src, n);
+
+		for (uint32 a = address & ~15; a < address + n; a += 16)
+			IPPU.TileDirty[a >> 9] |= 1u << ((a >> 4) & 31);
+
+		src += n;
+		bytes -= n;
+		address = 0;
+	}
+}
+
+static void DMABytesToWRAM (const uint8 *src, int32 bytes)
+{
+	while (bytes > 0)
+	{
+		int32	n = 0x20000 - PPU.WRAM;
+		if (n > bytes)
+			n = bytes;
+
+		memcpy(Memory.RAM + PPU.WRAM, src, n);
+
+		PPU.WRAM = (PPU.WRAM + n) & 0x1ffff;
+		src += n;
+		bytes -= n;
+	}
+}
+
 bool8 S9xDoDMA (uint8 Channel)
 {
 	CPU.InDMA = TRUE;
@@ -394,8 +455,22 @@ bool8 S9xDoDMA (uint8 Channel)
 				return (FALSE); \
 			}
 
+		// The first n bytes of a run found by bytesBeforeEvent() are written
+		// together, and their cycles added at once
+		#define	UPDATE_COUNTERS_BULK(n) \
+			d->TransferBytes -= (n); \
+			d->AAddress += inc * (n); \
+			p += inc * (n); \
+			count -= (n); \
+			ADD_CYCLES((n) * SLOW_ONE_CYCLE); \
+			CPU.HDMARanInDMA = 0;
+
+		#define	BULK_SOURCE(i)	(*(base + (uint16) (p + (i) * inc)))
+
 		while (1)
 		{
+			int32	n;
+
 			if (count > rem)
 				count = rem;
 			rem -= count;
@@ -560,24 +635,34 @@ bool8 S9xDoDMA (uint8 Channel)
 					switch (d->BAddress)
 					{
 						case 0x04: // OAMDATA
-							do
+							n = bytesBeforeEvent(Channel, count);
+							for (int32 i = 0; i < n; i++)
+								REGISTER_2104(BULK_SOURCE(i));
+							UPDATE_COUNTERS_BULK(n);
+
+							for (; count > 0; count--)
 							{
 								Work = *(base + p);
 								REGISTER_2104(Work);
 								UPDATE_COUNTERS;
-							} while (--count > 0);
+							}
 
 							break;
 
 						case 0x18: // VMDATAL
 							if (!PPU.VMA.FullGraphicCount)
 							{
-								do
+								n = bytesBeforeEvent(Channel, count);
+								for (int32 i = 0; i < n; i++)
+									REGISTER_2118_linear(BULK_SOURCE(i));
+								UPDATE_COUNTERS_BULK(n);
+
+								for (; count > 0; count--)
 								{
 									Work = *(base + p);
 									REGISTER_2118_linear(Work);
 									UPDATE_COUNTERS;
-								} while (--count > 0);
+								}
 							}
 							else
 							{
@@ -594,12 +679,17 @@ bool8 S9xDoDMA (uint8 Channel)
 						case 0x19: // VMDATAH
 							if (!PPU.VMA.FullGraphicCount)
 							{
-								do
+								n = bytesBeforeEvent(Channel, count);
+								for (int32 i = 0; i < n; i++)
+									REGISTER_2119_linear(BULK_SOURCE(i));
+								UPDATE_COUNTERS_BULK(n);
+
+								for (; count > 0; count--)
 								{
 									Work = *(base + p);
 									REGISTER_2119_linear(Work);
 									UPDATE_COUNTERS;
-								} while (--count > 0);
+								}
 							}
 							else
 							{
@@ -614,24 +704,39 @@ bool8 S9xDoDMA (uint8 Channel)
 							break;
 
 						case 0x22: // CGDATA
-							do
+							n = bytesBeforeEvent(Channel, count);
+							for (int32 i = 0; i < n; i++)
+								REGISTER_2122(BULK_SOURCE(i));
+							UPDATE_COUNTERS_BULK(n);
+
+							for (; count > 0; count--)
 							{
 								Work = *(base + p);
 								REGISTER_2122(Work);
 								UPDATE_COUNTERS;
-							} while (--count > 0);
+							}
 
 							break;
 
 						case 0x80: // WMDATA
 							if (!CPU.InWRAMDMAorHDMA)
 							{
-								do
+								n = bytesBeforeEvent(Channel, count);
+								if (inc == 1)
+									DMABytesToWRAM(base + p, n);
+								else
+								{
+									for (int32 i = 0; i < n; i++)
+										REGISTER_2180(BULK_SOURCE(i));
+								}
+								UPDATE_COUNTERS_BULK(n);
+
+								for (; count > 0; count--)
 								{
 									Work = *(base + p);
 									REGISTER_2180(Work);
 									UPDATE_COUNTERS;
-								} while (--count > 0);
+								}
 							}
 							else
 							{
@@ -662,6 +767,26 @@ bool8 S9xDoDMA (uint8 Channel)
 						// VMDATAL
 						if (!PPU.VMA.FullGraphicCount)
 						{
+							if (b == 0 && (n = bytesBeforeEvent(Channel, count) & ~1))
+							{
+								// CHECK_INBLANK() lets every write through, and each word follows the last
+								bool8	writable = !Settings.BlockInvalidVRAMAccess || PPU.ForcedBlanking || CPU.V_Counter >= PPU.ScreenHeight + FIRST_VISIBLE_LINE;
+
+								if (inc == 1 && writable && PPU.VMA.High && PPU.VMA.Increment == 1)
+									DMAWordsToVRAM(base + p, n);
+								else
+								{
+									for (int32 i = 0; i < n; i += 2)
+									{
+										REGISTER_2118_linear(BULK_SOURCE(i));
+										REGISTER_2119_linear(BULK_SOURCE(i + 1));
+									}
+								}
+
+								OpenBus = BULK_SOURCE(n - 1);
+								UPDATE_COUNTERS_BULK(n);
+							}
+
 							switch (b)
 							{
 								default:
@@ -870,6 +995,8 @@ bool8 S9xDoDMA (uint8 Channel)
 		}
 
 		#undef UPDATE_COUNTERS
+		#undef UPDATE_COUNTERS_BULK
+		#undef BULK_SOURCE
 	}
     else
     {
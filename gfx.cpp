@@ -18,29 +18,37 @@ extern struct SCheatData		Cheat;
 extern struct SLineData			LineData[240];
 extern struct SLineMatrixData	LineMatrixData[240];
 
+static void DrawOBJS (int);
+static void DrawBackground (int, uint8, uint8);
+static void DrawBackgroundMosaic (int, uint8, uint8);
+static void DrawBackgroundOffset (int, uint8, uint8, int);
+static void DrawBackgroundOffsetMosaic (int, uint8, uint8, int);
+static inline void DrawBackgroundMode7 (int, void (*DrawMath) (uint32, uint32, int), void (*DrawNomath) (uint32, uint32, int), int);
+static inline void DrawBackdrop (void);
+static inline void RenderScreen (bool8);
+
+#define TILE_PLUS(t, x)	(((t) & 0xfc00) | ((t + x) & 0x3ff))
+
+// gfxmt.cpp includes this file to build the drawing code a second time for
+// its worker threads, with RENDER_THREAD defined. Everything that belongs to
+// the emulation side is left out of that copy.
+#ifndef RENDER_THREAD
+
 void S9xComputeClipWindows (void);
 
 void (*S9xCustomDisplayString) (const char *, int, int, bool, int) = NULL;
 
 static void SetupOBJ (void);
-static void DrawOBJS (int);
 static void DisplayTime (void);
 static void DisplayFrameRate (void);
 static void DisplayPressedKeys (void);
 static void DisplayWatchedAddresses (void);
 static void DisplayStringFromBottom (const char *, int, int, bool);
-static void DrawBackground (int, uint8, uint8);
-static void DrawBackgroundMosaic (int, uint8, uint8);
-static void DrawBackgroundOffset (int, uint8, uint8, int);
-static void DrawBackgroundOffsetMosaic (int, uint8, uint8, int);
-static inline void DrawBackgroundMode7 (int, void (*DrawMath) (uint32, uint32, int), void (*DrawNomath) (uint32, uint32, int), int);
-static inline void DrawBackdrop (void);
-static inline void RenderScreen (bool8);
 static uint16 get_crosshair_color (uint8);
+static void DrawCrosshair (const char *, uint8, uint8, int16, int16, bool8, bool8, int);
+static void ForgetLines (uint32, uint32);
 static void S9xDisplayStringType (const char *, int, int, bool, int);
 
-#define TILE_PLUS(t, x)	(((t) & 0xfc00) | ((t + x) & 0x3ff))
-
 
 bool8 S9xGraphicsInit (void)
 {
@@ -103,6 +111,10 @@ bool8 S9xGraphicsInit (void)
 
 void S9xGraphicsDeinit (void)
 {
+#ifdef ALLOW_RENDER_THREADS
+	S9xStopRenderThreads();
+#endif
+
 	if (GFX.ZERO)       { free(GFX.ZERO);       GFX.ZERO       = NULL; }
 	if (GFX.SubScreen)  { free(GFX.SubScreen);  GFX.SubScreen  = NULL; }
 	if (GFX.ZBuffer)    { free(GFX.ZBuffer);    GFX.ZBuffer    = NULL; }
@@ -143,6 +155,8 @@ void S9xGraphicsScreenResize (void)
 	}
 }
 
+#endif
+
 void S9xBuildDirectColourMaps (void)
 {
 	IPPU.XB = mul_brightness[PPU.Brightness];
@@ -152,11 +166,125 @@ void S9xBuildDirectColourMaps (void)
 			DirectColourMaps[p][c] = BUILD_PIXEL(IPPU.XB[((c & 7) << 2) | ((p & 1) << 1)], IPPU.XB[((c & 0x38) >> 1) | (p & 2)], IPPU.XB[((c & 0xc0) >> 3) | (p & 4)]);
 }
 
+#ifndef RENDER_THREAD
+
+#ifdef ALLOW_RENDER_THREADS
+// With Settings.RenderPipeline a frame is shown at the end of the next one,
+// once it has been drawn. What S9xEndScreenRefresh() would have shown it with
+// is kept here until then.
+struct SShownFrame
+{
+	bool8	Pending;
+	bool8	FirstField;
+	int		Width;
+	int		Height;
+	bool8	DoubleWidth;
+	bool8	DoubleHeight;
+	int		ScreenHeight;
+	int		NumCrosshairs;
+
+	struct
+	{
+		const char	*Image;
+		uint8		FG;
+		uint8		BG;
+		int16		X;
+		int16		Y;
+	}	Crosshairs[8];
+};
+
+static struct SShownFrame	NextFrame, DrawnFrame;
+static bool8				RecordCrosshairs = FALSE;
+
+static void ShowDrawnFrame (void)
+{
+	int	width = DrawnFrame.Width, height = DrawnFrame.Height;
+
+	S9xWaitForScreenUpdates();
+
+	for (int i = 0; i < DrawnFrame.NumCrosshairs; i++)
+		DrawCrosshair(DrawnFrame.Crosshairs[i].Image, DrawnFrame.Crosshairs[i].FG, DrawnFrame.Crosshairs[i].BG,
+			DrawnFrame.Crosshairs[i].X, DrawnFrame.Crosshairs[i].Y, DrawnFrame.DoubleWidth, DrawnFrame.DoubleHeight, DrawnFrame.ScreenHeight);
+
+	if (DrawnFrame.FirstField)
+		S9xContinueUpdate(width, height);
+	else
+	{
+		if (Settings.TakeScreenshot)
+			S9xDoScreenshot(width, height);
+
+		if (Settings.AutoDisplayMessages)
+			S9xDisplayMessages(GFX.Screen, GFX.RealPPL, width, height, 1);
+
+		S9xDeinitUpdate(width, height);
+	}
+
+	DrawnFrame.Pending = FALSE;
+}
+
+static void EndPipelinedScreenRefresh (void)
+{
+	NextFrame.NumCrosshairs = 0;
+
+	if (IPPU.RenderThisFrame)
+	{
+		FLUSH_REDRAW();
+
+		NextFrame.FirstField = GFX.DoInterlace && S9xInterlaceField() == 0;
+		NextFrame.Width = IPPU.RenderedScreenWidth;
+		NextFrame.Height = IPPU.RenderedScreenHeight;
+		NextFrame.DoubleWidth = IPPU.DoubleWidthPixels;
+		NextFrame.DoubleHeight = IPPU.DoubleHeightPixels;
+		NextFrame.ScreenHeight = PPU.ScreenHeight;
+
+		if (!NextFrame.FirstField && IPPU.ColorsChanged)
+		{
+			uint32 saved = PPU.CGDATA[0];
+			IPPU.ColorsChanged = FALSE;
+			PPU.CGDATA[0] = saved;
+		}
+	}
+
+	// The screen still belongs to the render thread, so crosshairs are drawn later.
+	RecordCrosshairs = IPPU.RenderThisFrame;
+	S9xControlEOF();
+	RecordCrosshairs = FALSE;
+
+	if (DrawnFrame.Pending)
+		ShowDrawnFrame();
+
+	if (IPPU.RenderThisFrame)
+	{
+		S9xStartQueuedScreenUpdates();
+		DrawnFrame = NextFrame;
+		DrawnFrame.Pending = TRUE;
+	}
+}
+#endif
+
 void S9xStartScreenRefresh (void)
 {
+#ifdef ALLOW_RENDER_THREADS
+	// A frame still in the pipeline is shown before anything is drawn over it.
+	if (DrawnFrame.Pending && (!Settings.RenderPipeline || S9xScreenUpdatesQueued()))
+		ShowDrawnFrame();
+
+	// Changing the screen height late in a frame can skip S9xEndScreenRefresh().
+	S9xDrawQueuedScreenUpdates();
+#endif
+
 	if (GFX.DoInterlace)
 		GFX.DoInterlace--;
 
+	// Headless frames draw nothing. Their lines are only counted, and the
+	// range and time over flags of the counted lines are worked out when a
+	// flush needs them, the same way drawn lines wait for FLUSH_REDRAW().
+	if (Settings.Headless)
+	{
+		IPPU.RenderThisFrame = FALSE;
+		IPPU.PreviousLine = IPPU.CurrentLine = 0;
+	}
+
 	if (IPPU.RenderThisFrame)
 	{
 		if (!GFX.DoInterlace || !S9xInterlaceField())
@@ -176,8 +304,14 @@ void S9xStartScreenRefresh (void)
 		PPU.RecomputeClipWindows = TRUE;
 		IPPU.PreviousLine = IPPU.CurrentLine = 0;
 
-		memset(GFX.ZBuffer, 0, GFX.ScreenSize);
-		memset(GFX.SubZBuffer, 0, GFX.ScreenSize);
+	#ifdef ALLOW_RENDER_THREADS
+		// Queued lines clear their own part of the depth buffers when drawn.
+		if (!Settings.RenderThreads && !Settings.RenderPipeline)
+	#endif
+		{
+			memset(GFX.ZBuffer, 0, GFX.ScreenSize);
+			memset(GFX.SubZBuffer, 0, GFX.ScreenSize);
+		}
 	}
 
 	if (++IPPU.FrameCount == (uint32)Memory.ROMFramesPerSecond)
@@ -195,10 +329,25 @@ void S9xStartScreenRefresh (void)
 
 void S9xEndScreenRefresh (void)
 {
+	if (Settings.Headless)
+		FLUSH_REDRAW();
+
+#ifdef ALLOW_RENDER_THREADS
+	if (Settings.RenderPipeline)
+		EndPipelinedScreenRefresh();
+	else
+#endif
 	if (IPPU.RenderThisFrame)
 	{
 		FLUSH_REDRAW();
 
+	#ifdef ALLOW_RENDER_THREADS
+		S9xDrawQueuedScreenUpdates();
+	#endif
+
+		// Frontends may clear the rows below the picture
+		ForgetLines(IPPU.RenderedScreenHeight, MAX_SNES_HEIGHT - 1);
+
 		if (GFX.DoInterlace && S9xInterlaceField() == 0)
 		{
 			S9xControlEOF();
@@ -296,6 +445,9 @@ void RenderLine (uint8 C)
 		IPPU.CurrentLine = C + 1;
 	}
 	else
+	if (Settings.Headless)
+		IPPU.CurrentLine = C + 1;
+	else
 	{
 		// if we're not rendering this frame, we still need to update this
 		// XXX: Check ForceBlank? Or anything else?
@@ -305,6 +457,21 @@ void RenderLine (uint8 C)
 	}
 }
 
+#endif
+
+static inline void SelectLayer (int layer)
+{
+	if (!GFX.Compositing)
+		return;
+
+	// The layer buffers hold only the lines being drawn, with GFX.PPL set to SNES_WIDTH
+	GFX.S  = GFX.Layer[layer].Colour - GFX.StartY * SNES_WIDTH;
+	GFX.DB = GFX.Layer[layer].Depth  - GFX.StartY * SNES_WIDTH;
+	GFX.MB = GFX.Layer[layer].Math   - GFX.StartY * SNES_WIDTH;
+	memset(GFX.Layer[layer].Depth, 0, (GFX.EndY - GFX.StartY + 1) * SNES_WIDTH);
+	GFX.LayersDrawn |= 1 << layer;
+}
+
 static inline void RenderScreen (bool8 sub)
 {
 	uint8	BGActive;
@@ -337,6 +504,7 @@ static inline void RenderScreen (bool8 sub)
 		BG.StartPalette = 128;
 		S9xSelectTileConverter(4, FALSE, sub, FALSE);
 		S9xSelectTileRenderers(PPU.BGMode, sub, TRUE);
+		SelectLayer(4);
 		DrawOBJS(D + 4);
 	}
 
@@ -351,6 +519,7 @@ static inline void RenderScreen (bool8 sub)
 			BG.TileSizeH = (!hires && PPU.BG[n].BGSize) ? 16 : 8; \
 			BG.TileSizeV = (PPU.BG[n].BGSize) ? 16 : 8; \
 			S9xSelectTileConverter(depth, hires, sub, PPU.BGMosaic[n]); \
+			SelectLayer(n); \
 			\
 			if (offset) \
 			{ \
@@ -414,12 +583,14 @@ static inline void RenderScreen (bool8 sub)
 			if (BGActive & 0x01)
 			{
 				BG.EnableMath = !sub && (Memory.FillRAM[0x2131] & 1);
+				SelectLayer(0);
 				DrawBackgroundMode7(0, GFX.DrawMode7BG1Math, GFX.DrawMode7BG1Nomath, D);
 			}
 
 			if ((Memory.FillRAM[0x2133] & 0x40) && (BGActive & 0x02))
 			{
 				BG.EnableMath = !sub && (Memory.FillRAM[0x2131] & 2);
+				SelectLayer(1);
 				DrawBackgroundMode7(1, GFX.DrawMode7BG2Math, GFX.DrawMode7BG2Nomath, D);
 			}
 
@@ -430,11 +601,372 @@ static inline void RenderScreen (bool8 sub)
 
 	BG.EnableMath = !sub && (Memory.FillRAM[0x2131] & 0x20);
 
+	SelectLayer(5);
 	DrawBackdrop();
 }
 
+static void DoubleScreenWidth (uint32 lines, uint32 ppl)
+{
+	// Have to back out of the regular speed hack
+	for (uint32 y = 0; y < lines; y++)
+	{
+		uint16	*p = GFX.Screen + y * ppl + 255;
+		uint16	*q = GFX.Screen + y * ppl + 510;
+
+		for (int x = 255; x >= 0; x--, p--, q -= 2)
+			*q = *(q + 1) = *p;
+	}
+}
+
+static void DoubleScreenHeight (uint32 lines)
+{
+	uint32	ppl = GFX.RealPPL << 1;
+
+	for (int32 y = (int32) lines - 2; y >= 0; y--)
+		memmove(GFX.Screen + (y + 1) * ppl, GFX.Screen + y * GFX.RealPPL, ppl * sizeof(uint16));
+}
+
+static void CompositeLines (bool8 sub)
+{
+	// Draw a few lines of each layer into the layer buffers, then merge them into the screen
+	uint32	StartY = GFX.StartY, EndY = GFX.EndY, PPL = GFX.PPL;
+
+	GFX.Compositing = TRUE;
+
+	for (uint32 y = StartY, next; y <= EndY; y = next)
+	{
+		// A mosaic block takes its scroll from the line drawing starts on, so only split between blocks
+		next = y + COMPOSITE_LINES;
+		if (PPU.Mosaic > 1)
+			next -= ((uint32) next - PPU.MosaicStart) % PPU.Mosaic;
+
+		GFX.StartY = y;
+		GFX.EndY = (next - 1 < EndY) ? next - 1 : EndY;
+
+		if (sub)
+		{
+			GFX.PPL = SNES_WIDTH;
+			GFX.LayersDrawn = 0;
+			RenderScreen(TRUE);
+			GFX.PPL = PPL;
+
+			for (uint32 l = GFX.StartY; l <= GFX.EndY; l++)
+				GFX.CompositeLine(l, GFX.SubScreen + l * PPL, GFX.SubZBuffer + l * PPL);
+		}
+
+		GFX.PPL = SNES_WIDTH;
+		GFX.LayersDrawn = 0;
+		RenderScreen(FALSE);
+		GFX.PPL = PPL;
+
+		uint16	*Screen = GFX.Screen + GFX.StartY * PPL;
+		if (GFX.DoInterlace && S9xInterlaceField())
+			Screen += GFX.RealPPL;
+
+		for (uint32 l = GFX.StartY; l <= GFX.EndY; l++, Screen += PPL)
+			GFX.CompositeLine(l, Screen, NULL);
+	}
+
+	GFX.Compositing = FALSE;
+	GFX.StartY = StartY;
+	GFX.EndY = EndY;
+}
+
+static bool8 SubScreenNeeded (void)
+{
+	// Hires takes every other column from the subscreen
+	if (PPU.BGMode == 5 || PPU.BGMode == 6 || IPPU.PseudoHires)
+		return (TRUE);
+
+	// Otherwise only color math against the subscreen (not the fixed color) reads it
+	if ((Memory.FillRAM[0x2130] & 0x30) == 0x30 || !(Memory.FillRAM[0x2130] & 2) || !(Memory.FillRAM[0x212d] & 0x1f))
+		return (FALSE);
+
+	// ... and then only on layers that are drawn on the main screen in this
+	// mode, in regions where the color window lets math happen.
+	static const uint8	ModeBGs[8] = { 0x0f, 0x07, 0x03, 0x03, 0x03, 0x03, 0x01, 0x01 };
+
+	uint8	BGs = ModeBGs[PPU.BGMode];
+	if (PPU.BGMode == 7 && (Memory.FillRAM[0x2133] & 0x40))
+		BGs |= 0x02;
+
+	uint8	MathLayers = Memory.FillRAM[0x2131] & ((Memory.FillRAM[0x212c] & ~Settings.BG_Forced & (BGs | 0x10)) | 0x20);
+
+	for (int i = 0; i < 6; i++)
+	{
+		if (!(MathLayers & (1 << i)))
+			continue;
+
+		for (int clip = 0; clip < IPPU.Clip[0][i].Count; clip++)
+		{
+			if (IPPU.Clip[0][i].DrawMode[clip] & 2)
+				return (TRUE);
+		}
+	}
+
+	return (FALSE);
+}
+
+static void RenderLines (void)
+{
+	if (!PPU.ForcedBlanking)
+	{
+		bool8	sub = SubScreenNeeded();
+
+		// Lines drawn from before PPU.MosaicStart get their mosaic blocks from
+		// a wrapped unsigned modulo, which CompositeLines can't split them by.
+		bool8	wrapped = PPU.Mosaic > 1 && GFX.StartY < PPU.MosaicStart && (PPU.Mosaic & (PPU.Mosaic - 1));
+
+		if (Settings.LayerCompositor && !IPPU.DoubleWidthPixels && !wrapped)
+			CompositeLines(sub);
+		else
+		{
+			if (sub)
+				// If hires (Mode 5/6 or pseudo-hires) or math is to be done
+				// involving the subscreen, then we need to render the subscreen...
+				RenderScreen(TRUE);
+
+			RenderScreen(FALSE);
+		}
+	}
+	else
+	{
+		const uint16	black = BUILD_PIXEL(0, 0, 0);
+
+		GFX.S = GFX.Screen + GFX.StartY * GFX.PPL;
+		if (GFX.DoInterlace && S9xInterlaceField())
+			GFX.S += GFX.RealPPL;
+
+		for (uint32 l = GFX.StartY; l <= GFX.EndY; l++, GFX.S += GFX.PPL)
+			for (int x = 0; x < IPPU.RenderedScreenWidth; x++)
+				GFX.S[x] = black;
+	}
+}
+
+#ifndef RENDER_THREAD
+
+static inline uint64 HashWord (uint64 h, uint64 v)
+{
+	h = (h ^ v) * 0xbf58476d1ce4e5b9ULL;
+	return h ^ (h >> 31);
+}
+
+static uint64 HashBytes (uint64 h, const void *data, size_t size)
+{
+	const uint8	*p = (const uint8 *) data;
+	uint64		v;
+
+	for (; size >= 8; size -= 8, p += 8)
+	{
+		memcpy(&v, p, 8);
+		h = HashWord(h, v);
+	}
+
+	for (v = 0; size; size--)
+		v = (v << 8) | *p++;
+
+	return HashWord(h, v);
+}
+
+static uint8 VRAMRegions (uint32 start, uint32 size)
+{
+	// The 8 KB regions of VRAM that size bytes from start fall in, wrapping at 64 KB
+	if (size >= 0x10000)
+		return 0xff;
+
+	uint8	regions = 0;
+
+	for (uint32 r = start >> 13, last = (start + size - 1) >> 13; r <= last; r++)
+		regions |= 1 << (r & 7);
+
+	return regions;
+}
+
+static uint64 HashVRAM (uint64 h, uint8 regions)
+{
+	for (int r = 0; r < 8; r++)
+	{
+		if (regions & (1 << r))
+			h = HashWord(h, ((uint64) r << 32) | IPPU.VRAMGeneration[r]);
+	}
+
+	return h;
+}
+
+static inline uint32 LineRow (uint32 y)
+{
+	return y * (GFX.PPL / GFX.RealPPL) + ((GFX.DoInterlace && S9xInterlaceField()) ? 1 : 0);
+}
+
+static void ForgetLines (uint32 first, uint32 last)
+{
+	if (last >= MAX_SNES_HEIGHT)
+		last = MAX_SNES_HEIGHT - 1;
+
+	for (uint32 row = first; row <= last; row++)
+		GFX.LineHash[row] = 0;
+}
+
+static uint64 HashScreenState (uint8 BGActive)
+{
+	// Everything the lines from GFX.StartY to GFX.EndY share, apart from sprites
+	static const uint8	depths[7][4] =
+	{
+		{ 2, 2, 2, 2 }, { 4, 4, 2, 0 }, { 4, 4, 0, 0 }, { 8, 4, 0, 0 }, { 8, 2, 0, 0 }, { 4, 2, 0, 0 }, { 4, 0, 0, 0 }
+	};
+
+	uint64	h = HashWord(0, (uintptr_t) GFX.Screen);
+	uint8	regions = 0;
+
+	h = HashWord(h, GFX.PPL);
+	h = HashWord(h, (IPPU.Interlace || IPPU.InterlaceOBJ || GFX.DoInterlace) ? S9xInterlaceField() + 1 : 0);
+	h = HashWord(h, GFX.FixedColour);
+	h = HashBytes(h, &Memory.FillRAM[0x2105], 8);
+	h = HashBytes(h, &Memory.FillRAM[0x211a], 1);
+	h = HashBytes(h, &Memory.FillRAM[0x2123], 0x2134 - 0x2123);
+
+	h = HashWord(h, PPU.BGMode | (PPU.BG3Priority << 8) | (PPU.Mode7HFlip << 16) | (PPU.Mode7VFlip << 24) | ((uint64) PPU.Mode7Repeat << 32));
+	h = HashWord(h, PPU.Mosaic | (PPU.BGMosaic[0] << 8) | (PPU.BGMosaic[1] << 16) | (PPU.BGMosaic[2] << 24) | ((uint64) PPU.BGMosaic[3] << 32));
+
+	for (int bg = 0; bg < 4; bg++)
+		h = HashWord(h, PPU.BG[bg].SCBase | (PPU.BG[bg].NameBase << 16) | ((uint64) PPU.BG[bg].SCSize << 32) | ((uint64) PPU.BG[bg].BGSize << 48));
+
+	h = HashBytes(h, IPPU.Clip, sizeof(IPPU.Clip));
+	h = HashBytes(h, IPPU.ScreenColors, sizeof(IPPU.ScreenColors));
+	h = HashWord(h, (uintptr_t) IPPU.XB);
+	h = HashWord(h, IPPU.Interlace | (IPPU.InterlaceOBJ << 8) | (IPPU.PseudoHires << 16) | (IPPU.DoubleWidthPixels << 24) | ((uint64) IPPU.DoubleHeightPixels << 32));
+	h = HashWord(h, IPPU.RenderedScreenWidth);
+	h = HashWord(h, Settings.BG_Forced | (Settings.ForcedBackdrop << 8));
+
+	// VRAM is too big to hash, so each region a layer can read from adds how
+	// many times it has been written to instead. Tiles are taken one either
+	// side of the character data, for the hires converters that pair them up.
+	if (PPU.BGMode == 7)
+	{
+		if (BGActive & 3)
+			regions = 0x0f;
+	}
+	else
+	{
+		for (int bg = 0; bg < 4; bg++)
+		{
+			uint32	size = depths[PPU.BGMode][bg] * 8;
+
+			if (size && (BGActive & (1 << bg)))
+				regions |= VRAMRegions(PPU.BG[bg].SCBase << 1, 0x2000) |
+					VRAMRegions(((PPU.BG[bg].NameBase << 1) - size) & 0xffff, (0x400 + 2) * size);
+		}
+
+		if (PPU.BGMode == 2 || PPU.BGMode == 4 || PPU.BGMode == 6)
+			regions |= VRAMRegions(PPU.BG[2].SCBase << 1, 0x2000);
+	}
+
+	return HashVRAM(h, regions);
+}
+
+static uint64 HashLine (uint64 h, uint64 OBJState, uint32 y)
+{
+	h = HashWord(h, y);
+	h = HashBytes(h, &LineData[y], sizeof(LineData[y]));
+
+	if (PPU.BGMode == 7)
+		h = HashBytes(h, &LineMatrixData[y], sizeof(LineMatrixData[y]));
+
+	if (OBJState && GFX.OBJLines[y].OBJ[0].Sprite >= 0)
+	{
+		int	sprite_limit = (Settings.MaxSpriteTilesPerLine == 128) ? 128 : 32;
+
+		h = HashWord(h, OBJState);
+		h = HashWord(h, (uint16) GFX.OBJLines[y].Tiles);
+
+		for (int I = 0, S = GFX.OBJLines[y].OBJ[0].Sprite; S >= 0 && I < sprite_limit; S = GFX.OBJLines[y].OBJ[++I].Sprite)
+		{
+			h = HashWord(h, S | (GFX.OBJLines[y].OBJ[I].Line << 8) | (GFX.OBJWidths[S] << 16) | ((uint64) (uint8) GFX.OBJVisibleTiles[S] << 24));
+			h = HashBytes(h, &PPU.OBJ[S], sizeof(PPU.OBJ[S]));
+		}
+	}
+
+	return h ? h : 1;
+}
+
+static void RenderChangedLines (void)
+{
+	// Settings.ReuseLines: a line whose hash matches the one its row was last
+	// drawn with is left as it is, and only runs of changed lines are drawn.
+	uint32	StartY = GFX.StartY, EndY = GFX.EndY;
+
+	// A mosaic block takes its scroll from the line drawing starts on, so its
+	// lines aren't independent of each other.
+	if (PPU.ForcedBlanking || PPU.Mosaic > 1)
+	{
+		ForgetLines(LineRow(StartY), LineRow(EndY));
+		RenderLines();
+		return;
+	}
+
+	uint8	BGActive = (Memory.FillRAM[0x212c] | Memory.FillRAM[0x212d]) & ~Settings.BG_Forced;
+	uint64	state = HashScreenState(BGActive);
+	uint64	OBJState = 0;
+
+	if (BGActive & 0x10)
+	{
+		OBJState = HashWord(1, PPU.OBJNameBase | (PPU.OBJNameSelect << 16) | ((uint64) Settings.MaxSpriteTilesPerLine << 32));
+		OBJState = HashVRAM(OBJState, VRAMRegions(PPU.OBJNameBase, 0x2000) | VRAMRegions((PPU.OBJNameBase + 0x2000 + PPU.OBJNameSelect) & 0xffff, 0x2000));
+	}
+
+	for (uint32 y = StartY, end; y <= EndY; y = end + 1)
+	{
+		uint64	h = HashLine(state, OBJState, y);
+
+		end = y;
+		if (GFX.LineHash[LineRow(y)] == h)
+			continue;
+
+		GFX.LineHash[LineRow(y)] = h;
+
+		for (; end < EndY; end++)
+		{
+			h = HashLine(state, OBJState, end + 1);
+			if (GFX.LineHash[LineRow(end + 1)] == h)
+				break;
+
+			GFX.LineHash[LineRow(end + 1)] = h;
+		}
+
+		GFX.StartY = y;
+		GFX.EndY = end;
+		RenderLines();
+
+		// The matching line after the run needn't be hashed again
+		if (end < EndY)
+			end++;
+	}
+
+	GFX.StartY = StartY;
+	GFX.EndY = EndY;
+}
+
 void S9xUpdateScreen (void)
 {
+	uint32	widen_ppl = 0;
+	bool8	deepen = FALSE;
+
+	if (Settings.Headless && !IPPU.RenderThisFrame)
+	{
+		// OBJLines RTOFlags accumulate down the screen, so the last line
+		// waiting covers all of them. Sprites are only set up again if a
+		// flag is still clear.
+		if (PPU.RangeTimeOver != 0xc0)
+		{
+			if (IPPU.OBJChanged)
+				SetupOBJ();
+			PPU.RangeTimeOver |= GFX.OBJLines[IPPU.CurrentLine - 1].RTOFlags;
+		}
+
+		IPPU.PreviousLine = IPPU.CurrentLine;
+		return;
+	}
+
 	if (IPPU.OBJChanged || IPPU.InterlaceOBJ)
 		SetupOBJ();
 
@@ -458,58 +990,80 @@ void S9xUpdateScreen (void)
 
 		if (!IPPU.DoubleWidthPixels && (PPU.BGMode == 5 || PPU.BGMode == 6 || IPPU.PseudoHires))
 		{
-			// Have to back out of the regular speed hack
-			for (uint32 y = 0; y < GFX.StartY; y++)
-			{
-				uint16	*p = GFX.Screen + y * GFX.PPL + 255;
-				uint16	*q = GFX.Screen + y * GFX.PPL + 510;
-
-				for (int x = 255; x >= 0; x--, p--, q -= 2)
-					*q = *(q + 1) = *p;
-			}
-
+			widen_ppl = GFX.PPL;
 			IPPU.DoubleWidthPixels = TRUE;
 			IPPU.RenderedScreenWidth = 512;
 		}
 
 		if (!IPPU.DoubleHeightPixels && IPPU.Interlace && (PPU.BGMode == 5 || PPU.BGMode == 6))
 		{
+			deepen = TRUE;
 			IPPU.DoubleHeightPixels = TRUE;
 			IPPU.RenderedScreenHeight = PPU.ScreenHeight << 1;
 			GFX.PPL = GFX.RealPPL << 1;
 			GFX.DoInterlace = 2;
-
-			for (int32 y = (int32) GFX.StartY - 2; y >= 0; y--)
-				memmove(GFX.Screen + (y + 1) * GFX.PPL, GFX.Screen + y * GFX.RealPPL, GFX.PPL * sizeof(uint16));
 		}
 
 		if ((Memory.FillRAM[0x2130] & 0x30) != 0x30 && (Memory.FillRAM[0x2131] & 0x3f))
 			GFX.FixedColour = BUILD_PIXEL(IPPU.XB[PPU.FixedColourRed], IPPU.XB[PPU.FixedColourGreen], IPPU.XB[PPU.FixedColourBlue]);
+	}
 
-		if (PPU.BGMode == 5 || PPU.BGMode == 6 || IPPU.PseudoHires ||
-			((Memory.FillRAM[0x2130] & 0x30) != 0x30 && (Memory.FillRAM[0x2130] & 2) && (Memory.FillRAM[0x2131] & 0x3f) && (Memory.FillRAM[0x212d] & 0x1f)))
-			// If hires (Mode 5/6 or pseudo-hires) or math is to be done
-			// involving the subscreen, then we need to render the subscreen...
-			RenderScreen(TRUE);
-
-		RenderScreen(FALSE);
+#ifdef ALLOW_RENDER_THREADS
+	if (Settings.RenderThreads || Settings.RenderPipeline)
+	{
+		ForgetLines(0, MAX_SNES_HEIGHT - 1);
+		S9xQueueScreenUpdate(widen_ppl, deepen);
 	}
 	else
+#endif
 	{
-		const uint16	black = BUILD_PIXEL(0, 0, 0);
+		if (widen_ppl || deepen)
+			ForgetLines(0, GFX.StartY * 2);
+		if (widen_ppl)
+			DoubleScreenWidth(GFX.StartY, widen_ppl);
+		if (deepen)
+			DoubleScreenHeight(GFX.StartY);
 
-		GFX.S = GFX.Screen + GFX.StartY * GFX.PPL;
-		if (GFX.DoInterlace && S9xInterlaceField())
-			GFX.S += GFX.RealPPL;
+		S9xInvalidateDirtyTiles();
 
-		for (uint32 l = GFX.StartY; l <= GFX.EndY; l++, GFX.S += GFX.PPL)
-			for (int x = 0; x < IPPU.RenderedScreenWidth; x++)
-				GFX.S[x] = black;
+		if (Settings.ReuseLines)
+			RenderChangedLines();
+		else
+		{
+			ForgetLines(LineRow(GFX.StartY), LineRow(GFX.EndY));
+			RenderLines();
+		}
 	}
 
 	IPPU.PreviousLine = IPPU.CurrentLine;
 }
 
+// What GFX.OBJLines was last built from: which sprites are on each line, one
+// bit per sprite; for each sprite, the first line and number of lines it's
+// on, the line flip and its visible tiles; each line's own range and time
+// over flags; and the settings shared by every line.
+static uint32	OBJOnLine[SNES_HEIGHT_EXTENDED][4];
+static uint8	OBJLineY[128];
+static uint8	OBJLineCount[128];
+static uint8	OBJLineFlip[128];
+static uint8	OBJLineTiles[128];
+static uint8	OBJLineRTO[SNES_HEIGHT_EXTENDED];
+static uint32	OBJLinesKey = ~0u;
+
+static inline int LowestBit (uint32 bits)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(bits);
+#else
+	int	n = 0;
+
+	for (; !(bits & 1); bits >>= 1)
+		n++;
+
+	return n;
+#endif
+}
+
 static void SetupOBJ (void)
 {
 	int	SmallWidth, SmallHeight, LargeWidth, LargeHeight;
@@ -564,187 +1118,256 @@ static void SetupOBJ (void)
 
 	// OK, we have three cases here. Either there's no priority, priority is
 	// normal FirstSprite, or priority is FirstSprite+Y. The first two are
-	// easy, the last is somewhat more ... interesting. So we split them up.
+	// easy, the last is somewhat more ... interesting. They only differ in
+	// where each line starts looking for sprites, and in how a sprite at
+	// HPos -256 is clipped.
 
-	int		Height;
-	uint8	S;
+	bool8	evil = PPU.OAMPriorityRotation && (PPU.OAMFlip & PPU.OAMAddr & 1);
 	int sprite_limit = (Settings.MaxSpriteTilesPerLine == 128) ? 128 : 32;
+	uint32	key = PPU.FirstSprite | (evil << 7) | (startline << 8) | (inc << 9) | ((Settings.MaxSpriteTilesPerLine & 0xff) << 16);
 
-	if (!PPU.OAMPriorityRotation || !(PPU.OAMFlip & PPU.OAMAddr & 1)) // normal case
+	uint8	LineY[128], LineCount[128], LineFlip[128], LineTiles[128];
+	uint8	moved[128];
+	int		nmoved = 0;
+
+	for (int S = 0; S < 128; S++)
 	{
-		uint8	LineOBJ[SNES_HEIGHT_EXTENDED];
-		memset(LineOBJ, 0, sizeof(LineOBJ));
+		int	Height;
 
-		for (int i = 0; i < SNES_HEIGHT_EXTENDED; i++)
+		if (PPU.OBJ[S].Size)
 		{
-			GFX.OBJLines[i].RTOFlags = 0;
-			GFX.OBJLines[i].Tiles = Settings.MaxSpriteTilesPerLine;
-			for (int j = 0; j < sprite_limit; j++)
-				GFX.OBJLines[i].OBJ[j].Sprite = -1;
+			GFX.OBJWidths[S] = LargeWidth;
+			Height = LargeHeight;
+		}
+		else
+		{
+			GFX.OBJWidths[S] = SmallWidth;
+			Height = SmallHeight;
 		}
 
-		uint8	FirstSprite = PPU.FirstSprite;
-		S = FirstSprite;
+		int	HPos = PPU.OBJ[S].HPos;
+		if (HPos == -256)
+			HPos = evil ? 256 : 0;
 
-		do
+		// Yes, Width not Height. It so happens that the sprites with H=2*W
+		// flip as two WxW sprites.
+		LineFlip[S] = PPU.OBJ[S].VFlip ? GFX.OBJWidths[S] - 1 : 0;
+		LineY[S] = (uint8) (PPU.OBJ[S].VPos & 0xff);
+		LineCount[S] = 0;
+		LineTiles[S] = 0;
+
+		if (HPos > -GFX.OBJWidths[S] && HPos <= 256)
 		{
-			if (PPU.OBJ[S].Size)
-			{
-				GFX.OBJWidths[S] = LargeWidth;
-				Height = LargeHeight;
-			}
+			if (HPos < 0)
+				GFX.OBJVisibleTiles[S] = (GFX.OBJWidths[S] + HPos + 7) >> 3;
+			else if (!evil && HPos + GFX.OBJWidths[S] > 255)
+				GFX.OBJVisibleTiles[S] = (256 - HPos + 7) >> 3;
+			else if (evil && HPos + GFX.OBJWidths[S] >= 257)
+				GFX.OBJVisibleTiles[S] = (257 - HPos + 7) >> 3;
 			else
-			{
-				GFX.OBJWidths[S] = SmallWidth;
-				Height = SmallHeight;
-			}
+				GFX.OBJVisibleTiles[S] = GFX.OBJWidths[S] >> 3;
 
-			int	HPos = PPU.OBJ[S].HPos;
-			if (HPos == -256)
-				HPos = 0;
+			LineCount[S] = Height / inc;
+			LineTiles[S] = GFX.OBJVisibleTiles[S];
+		}
 
-			if (HPos > -GFX.OBJWidths[S] && HPos <= 256)
-			{
-				if (HPos < 0)
-					GFX.OBJVisibleTiles[S] = (GFX.OBJWidths[S] + HPos + 7) >> 3;
-				else if (HPos + GFX.OBJWidths[S] > 255)
-					GFX.OBJVisibleTiles[S] = (256 - HPos + 7) >> 3;
-				else
-					GFX.OBJVisibleTiles[S] = GFX.OBJWidths[S] >> 3;
+		if (LineY[S] != OBJLineY[S] || LineCount[S] != OBJLineCount[S] || LineFlip[S] != OBJLineFlip[S] || LineTiles[S] != OBJLineTiles[S])
+			moved[nmoved++] = S;
+	}
 
-				for (uint8 line = startline, Y = (uint8) (PPU.OBJ[S].VPos & 0xff); line < Height; Y++, line += inc)
-				{
-					if (Y >= SNES_HEIGHT_EXTENDED)
-						continue;
+	// Only the lines of the sprites that changed are built again, unless
+	// something every line depends on changed. After an OAM DMA most sprites
+	// have moved, and which sprites are on each line is worked out afresh.
+	bool8	all = (key != OBJLinesKey) || nmoved > 32;
+	bool8	touched[SNES_HEIGHT_EXTENDED];
 
-					if (LineOBJ[Y] >= sprite_limit)
-					{
-						GFX.OBJLines[Y].RTOFlags |= 0x40;
-						continue;
-					}
+	memset(touched, all, sizeof(touched));
 
-					GFX.OBJLines[Y].Tiles -= GFX.OBJVisibleTiles[S];
-					if (GFX.OBJLines[Y].Tiles < 0)
-						GFX.OBJLines[Y].RTOFlags |= 0x80;
+	if (nmoved > 32)
+	{
+		memcpy(OBJLineY, LineY, sizeof(OBJLineY));
+		memcpy(OBJLineCount, LineCount, sizeof(OBJLineCount));
 
-					GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Sprite = S;
-					if (PPU.OBJ[S].VFlip)
-						// Yes, Width not Height. It so happens that the
-						// sprites with H=2*W flip as two WxW sprites.
-						GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Line = line ^ (GFX.OBJWidths[S] - 1);
-					else
-						GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Line = line;
+	#ifdef HAVE_SSE2
+		// A sprite is on line Y when (uint8) (Y - first line) < count, sixteen sprites at a time
+		for (int w = 0; w < 4; w++)
+		{
+			__m128i	first0 = _mm_loadu_si128((__m128i *) &OBJLineY[w * 32]);
+			__m128i	first1 = _mm_loadu_si128((__m128i *) &OBJLineY[w * 32 + 16]);
+			__m128i	count0 = _mm_loadu_si128((__m128i *) &OBJLineCount[w * 32]);
+			__m128i	count1 = _mm_loadu_si128((__m128i *) &OBJLineCount[w * 32 + 16]);
+			__m128i	line = _mm_setzero_si128();
 
-					LineOBJ[Y]++;
-				}
-			}
+			for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
+			{
+				__m128i	d0 = _mm_sub_epi8(line, first0);
+				__m128i	d1 = _mm_sub_epi8(line, first1);
+				uint32	m0 = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d0, count0), count0));
+				uint32	m1 = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d1, count1), count1));
 
-			S = (S + 1) & 0x7f;
-		} while (S != FirstSprite);
+				OBJOnLine[Y][w] = ~(m0 | (m1 << 16));
+				line = _mm_add_epi8(line, _mm_set1_epi8(1));
+			}
+		}
+	#else
+		memset(OBJOnLine, 0, sizeof(OBJOnLine));
 
-		for (int Y = 1; Y < SNES_HEIGHT_EXTENDED; Y++)
-			GFX.OBJLines[Y].RTOFlags |= GFX.OBJLines[Y - 1].RTOFlags;
+		for (int S = 0; S < 128; S++)
+		{
+			for (uint8 n = 0, Y = OBJLineY[S]; n < OBJLineCount[S]; n++, Y++)
+			{
+				if (Y < SNES_HEIGHT_EXTENDED)
+					OBJOnLine[Y][S >> 5] |= 1u << (S & 31);
+			}
+		}
+	#endif
 	}
-	else // evil FirstSprite+Y case
+	else
 	{
-		// First, find out which sprites are on which lines
-		uint8 OBJOnLine[SNES_HEIGHT_EXTENDED][128];
-		// memset(OBJOnLine, 0, sizeof(OBJOnLine));
-		/* Hold on here, that's a lot of bytes to initialise at once!
-		 * So we only initialise them per line, as needed. [Neb]
-		 * Bonus: We can quickly avoid looping if a line has no OBJs.
-		 */
-        bool8 AnyOBJOnLine[SNES_HEIGHT_EXTENDED];
-        memset(AnyOBJOnLine, FALSE, sizeof(AnyOBJOnLine)); // better
-
-		for (S = 0; S < 128; S++)
+		for (int i = 0; i < nmoved; i++)
 		{
-			if (PPU.OBJ[S].Size)
+			int	S = moved[i];
+
+			for (uint8 n = 0, Y = OBJLineY[S]; n < OBJLineCount[S]; n++, Y++)
 			{
-				GFX.OBJWidths[S] = LargeWidth;
-				Height = LargeHeight;
+				if (Y < SNES_HEIGHT_EXTENDED)
+				{
+					OBJOnLine[Y][S >> 5] &= ~(1u << (S & 31));
+					touched[Y] = TRUE;
+				}
 			}
-			else
+
+			OBJLineY[S] = LineY[S];
+			OBJLineCount[S] = LineCount[S];
+
+			for (uint8 n = 0, Y = OBJLineY[S]; n < OBJLineCount[S]; n++, Y++)
 			{
-				GFX.OBJWidths[S] = SmallWidth;
-				Height = SmallHeight;
+				if (Y < SNES_HEIGHT_EXTENDED)
+				{
+					OBJOnLine[Y][S >> 5] |= 1u << (S & 31);
+					touched[Y] = TRUE;
+				}
 			}
+		}
+	}
+
+	memcpy(OBJLineFlip, LineFlip, sizeof(OBJLineFlip));
+	memcpy(OBJLineTiles, LineTiles, sizeof(OBJLineTiles));
+	OBJLinesKey = key;
+
+	// Now go through and pull out those OBJ that are actually visible.
+	if (all && !evil)
+	{
+		// Every line starts at FirstSprite, so it's quicker to go sprite by
+		// sprite than line by line.
+		uint8	LineOBJ[SNES_HEIGHT_EXTENDED];
+		memset(LineOBJ, 0, sizeof(LineOBJ));
+		memset(OBJLineRTO, 0, sizeof(OBJLineRTO));
+
+		for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
+			GFX.OBJLines[Y].Tiles = Settings.MaxSpriteTilesPerLine;
 
-			int	HPos = PPU.OBJ[S].HPos;
-			if (HPos == -256)
-				HPos = 256;
+		uint8	S = PPU.FirstSprite;
 
-			if (HPos > -GFX.OBJWidths[S] && HPos <= 256)
+		do
+		{
+			for (uint8 n = 0, Y = OBJLineY[S]; n < OBJLineCount[S]; n++, Y++)
 			{
-				if (HPos < 0)
-					GFX.OBJVisibleTiles[S] = (GFX.OBJWidths[S] + HPos + 7) >> 3;
-				else if (HPos + GFX.OBJWidths[S] >= 257)
-					GFX.OBJVisibleTiles[S] = (257 - HPos + 7) >> 3;
-				else
-					GFX.OBJVisibleTiles[S] = GFX.OBJWidths[S] >> 3;
+				if (Y >= SNES_HEIGHT_EXTENDED)
+					continue;
 
-				for (uint8 line = startline, Y = (uint8) (PPU.OBJ[S].VPos & 0xff); line < Height; Y++, line += inc)
+				if (LineOBJ[Y] >= sprite_limit)
 				{
-					if (Y >= SNES_HEIGHT_EXTENDED)
-						continue;
+					OBJLineRTO[Y] |= 0x40;
+					continue;
+				}
 
-					if (!AnyOBJOnLine[Y]) {
-						memset(OBJOnLine[Y], 0, sizeof(OBJOnLine[Y]));
-						AnyOBJOnLine[Y] = TRUE;
-					}
+				GFX.OBJLines[Y].Tiles -= OBJLineTiles[S];
+				if (GFX.OBJLines[Y].Tiles < 0)
+					OBJLineRTO[Y] |= 0x80;
 
-					if (PPU.OBJ[S].VFlip)
-						// Yes, Width not Height. It so happens that the
-						// sprites with H=2*W flip as two WxW sprites.
-						OBJOnLine[Y][S] = (line ^ (GFX.OBJWidths[S] - 1)) | 0x80;
-					else
-						OBJOnLine[Y][S] = line | 0x80;
-				}
+				GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Sprite = S;
+				GFX.OBJLines[Y].OBJ[LineOBJ[Y]++].Line = (startline + n * inc) ^ OBJLineFlip[S];
 			}
-		}
 
-		// Now go through and pull out those OBJ that are actually visible.
-		int	j;
+			S = (S + 1) & 0x7f;
+		} while (S != PPU.FirstSprite);
+
 		for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
 		{
-			GFX.OBJLines[Y].RTOFlags = Y ? GFX.OBJLines[Y - 1].RTOFlags : 0;
-			GFX.OBJLines[Y].Tiles = Settings.MaxSpriteTilesPerLine;
+			if (LineOBJ[Y] < sprite_limit)
+				GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Sprite = -1;
+		}
+	}
+	else
+	for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
+	{
+		if (!touched[Y])
+			continue;
+
+		uint32	*OnLine = OBJOnLine[Y];
+		uint8	RTOFlags = 0;
+		int		Tiles = Settings.MaxSpriteTilesPerLine;
+		int		j = 0;
 
-			uint8	FirstSprite = (PPU.FirstSprite + Y) & 0x7f;
-			S = FirstSprite;
-			j = 0;
+		if (OnLine[0] | OnLine[1] | OnLine[2] | OnLine[3])
+		{
+			// Starting at FirstSprite, take the sprites in the word it's in,
+			// then the next three words, then the rest of the first word.
+			int		FirstSprite = (PPU.FirstSprite + (evil ? Y : 0)) & 0x7f;
+			int		w = FirstSprite >> 5;
+			uint32	head = OnLine[w] & (~0u << (FirstSprite & 31));
 
-			if (AnyOBJOnLine[Y])
+			for (int part = 0; part < 5; part++)
 			{
-				do
+				uint32	bits;
+				int		base;
+
+				if (part == 0)
+					bits = head, base = w << 5;
+				else if (part < 4)
+					bits = OnLine[(w + part) & 3], base = ((w + part) & 3) << 5;
+				else
+					bits = OnLine[w] & ~head, base = w << 5;
+
+				for (; bits; bits &= bits - 1)
 				{
-					if (OBJOnLine[Y][S])
-					{
-						if (j >= sprite_limit)
-						{
-							GFX.OBJLines[Y].RTOFlags |= 0x40;
-							break;
-						}
+					int	S = base + LowestBit(bits);
 
-						GFX.OBJLines[Y].Tiles -= GFX.OBJVisibleTiles[S];
-						if (GFX.OBJLines[Y].Tiles < 0)
-							GFX.OBJLines[Y].RTOFlags |= 0x80;
-						GFX.OBJLines[Y].OBJ[j].Sprite = S;
-						GFX.OBJLines[Y].OBJ[j++].Line = OBJOnLine[Y][S] & ~0x80;
+					if (j >= sprite_limit)
+					{
+						RTOFlags |= 0x40;
+						part = 5;
+						break;
 					}
 
-					S = (S + 1) & 0x7f;
-				} while (S != FirstSprite);
-			}
+					Tiles -= OBJLineTiles[S];
 
-			if (j < sprite_limit)
-				GFX.OBJLines[Y].OBJ[j].Sprite = -1;
+					GFX.OBJLines[Y].OBJ[j].Sprite = S;
+					GFX.OBJLines[Y].OBJ[j++].Line = (startline + (uint8) (Y - OBJLineY[S]) * inc) ^ OBJLineFlip[S];
+				}
+			}
 		}
+
+		// No sprite has less than one visible tile, so Tiles only goes down
+		if (Tiles < 0)
+			RTOFlags |= 0x80;
+
+		OBJLineRTO[Y] = RTOFlags;
+		GFX.OBJLines[Y].Tiles = Tiles;
+
+		if (j < sprite_limit)
+			GFX.OBJLines[Y].OBJ[j].Sprite = -1;
 	}
 
+	for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
+		GFX.OBJLines[Y].RTOFlags = (Y ? GFX.OBJLines[Y - 1].RTOFlags : 0) | OBJLineRTO[Y];
+
 	IPPU.OBJChanged = FALSE;
 }
 
+#endif
+
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC push_options
 #pragma GCC optimize ("no-tree-vrp")
@@ -1089,10 +1712,10 @@ static void DrawBackgroundMosaic (int bg, uint8 Zh, uint8 Zl)
 
 	void (*DrawPix) (uint32, uint32, uint32, uint32, uint32, uint32);
 
-	int	MosaicStart = ((uint32) GFX.StartY - PPU.MosaicStart) % PPU.Mosaic;
-
 	for (int clip = 0; clip < GFX.Clip[bg].Count; clip++)
 	{
+		int	MosaicStart = ((uint32) GFX.StartY - PPU.MosaicStart) % PPU.Mosaic;
+
 		GFX.ClipColors = !(GFX.Clip[bg].DrawMode[clip] & 1);
 
 		if (BG.EnableMath && (GFX.Clip[bg].DrawMode[clip] & 2))
@@ -1347,8 +1970,9 @@ static void DrawBackgroundOffset (int bg, uint8 Zh, uint8 Zl, int VOffOff)
 					uint16	HCellOffset = READ_WORD(s);
 					uint16	VCellOffset;
 
+					// The right-hand screen's row can run past the end of VRAM
 					if (VOffOff)
-						VCellOffset = READ_WORD(s + VOffsetOffset);
+						VCellOffset = READ_WORD((uint16 *) Memory.VRAM + ((s - (uint16 *) Memory.VRAM + VOffsetOffset) & 0x7fff));
 					else
 					{
 						if (HCellOffset & 0x8000)
@@ -1497,10 +2121,10 @@ static void DrawBackgroundOffsetMosaic (int bg, uint8 Zh, uint8 Zl, int VOffOff)
 
 	void (*DrawPix) (uint32, uint32, uint32, uint32, uint32, uint32);
 
-	int	MosaicStart = ((uint32) GFX.StartY - PPU.MosaicStart) % PPU.Mosaic;
-
 	for (int clip = 0; clip < GFX.Clip[bg].Count; clip++)
 	{
+		int	MosaicStart = ((uint32) GFX.StartY - PPU.MosaicStart) % PPU.Mosaic;
+
 		GFX.ClipColors = !(GFX.Clip[bg].DrawMode[clip] & 1);
 
 		if (BG.EnableMath && (GFX.Clip[bg].DrawMode[clip] & 2))
@@ -1576,8 +2200,9 @@ static void DrawBackgroundOffsetMosaic (int bg, uint8 Zh, uint8 Zl, int VOffOff)
 					uint16	HCellOffset = READ_WORD(s);
 					uint16	VCellOffset;
 
+					// The right-hand screen's row can run past the end of VRAM
 					if (VOffOff)
-						VCellOffset = READ_WORD(s + VOffsetOffset);
+						VCellOffset = READ_WORD((uint16 *) Memory.VRAM + ((s - (uint16 *) Memory.VRAM + VOffsetOffset) & 0x7fff));
 					else
 					{
 						if (HCellOffset & 0x8000)
@@ -1713,12 +2338,67 @@ static inline void DrawBackdrop (void)
 	}
 }
 
+#ifndef RENDER_THREAD
+
 void S9xReRefresh (void)
 {
 	// Be careful when calling this function from the thread other than the emulation one...
 	// Here it's assumed no drawing occurs from the emulation thread when Settings.Paused is TRUE.
 	if (Settings.Paused)
+	{
+	#ifdef ALLOW_RENDER_THREADS
+		S9xWaitForScreenUpdates();
+	#endif
 		S9xDeinitUpdate(IPPU.RenderedScreenWidth, IPPU.RenderedScreenHeight);
+	}
+}
+
+// Expands a 16-bit image to 0x00RRGGBB for frontends that want 32-bit pixels.
+// Channels are widened by repeating their top bits, so white stays 0xffffff.
+void S9xConvertToXRGB8888 (const uint16 *src, int src_pitch, uint32 *dst, int dst_pitch, int width, int height)
+{
+	#define EXPAND5(c)	(((c) << 3) | ((c) >> 2))
+	#define EXPANDG(c)	(MAX_GREEN == 63 ? (((c) << 2) | ((c) >> 4)) : EXPAND5(c))
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint16	*s = (const uint16 *) ((const uint8 *) src + y * src_pitch);
+		uint32			*d = (uint32 *) ((uint8 *) dst + y * dst_pitch);
+		int				x = 0;
+
+	#ifdef HAVE_SSE2
+		const __m128i	mask5 = _mm_set1_epi16(0x1f);
+		const __m128i	maskg = _mm_set1_epi16(MAX_GREEN);
+
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i	p = _mm_loadu_si128((const __m128i *) (s + x));
+			__m128i	r = _mm_and_si128(_mm_srli_epi16(p, RED_SHIFT_BITS), mask5);
+			__m128i	g = _mm_and_si128(_mm_srli_epi16(p, 5), maskg);
+			__m128i	b = _mm_and_si128(p, mask5);
+
+			r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+			b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+			if (MAX_GREEN == 63)
+				g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+			else
+				g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+
+			__m128i	gb = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+			_mm_storeu_si128((__m128i *) (d + x), _mm_unpacklo_epi16(gb, r));
+			_mm_storeu_si128((__m128i *) (d + x + 4), _mm_unpackhi_epi16(gb, r));
+		}
+	#endif
+
+		for (; x < width; x++)
+		{
+			uint32	r = (s[x] >> RED_SHIFT_BITS) & 0x1f, g = (s[x] >> 5) & MAX_GREEN, b = s[x] & 0x1f;
+			d[x] = (EXPAND5(r) << 16) | (EXPANDG(g) << 8) | EXPAND5(b);
+		}
+	}
+
+	#undef EXPAND5
+	#undef EXPANDG
 }
 
 void S9xSetInfoString (const char *string)
@@ -1795,6 +2475,8 @@ void S9xVariableDisplayString(const char* string, int linesFromBottom,	int pixel
 	if (GFX.ScreenBuffer.empty() || IPPU.RenderedScreenWidth == 0)
 		return;
 
+	ForgetLines(0, MAX_SNES_HEIGHT - 1);
+
 	bool monospace = true;
 	if (type == S9X_NO_INFO)
 	{
@@ -2138,14 +2820,38 @@ void S9xDrawCrosshair (const char *crosshair, uint8 fgcolor, uint8 bgcolor, int1
 	if (!crosshair)
 		return;
 
-	int16	r, rx = 1, c, cx = 1, W = SNES_WIDTH, H = PPU.ScreenHeight;
+#ifdef ALLOW_RENDER_THREADS
+	if (RecordCrosshairs)
+	{
+		if (NextFrame.NumCrosshairs < 8)
+		{
+			NextFrame.Crosshairs[NextFrame.NumCrosshairs].Image = crosshair;
+			NextFrame.Crosshairs[NextFrame.NumCrosshairs].FG = fgcolor;
+			NextFrame.Crosshairs[NextFrame.NumCrosshairs].BG = bgcolor;
+			NextFrame.Crosshairs[NextFrame.NumCrosshairs].X = x;
+			NextFrame.Crosshairs[NextFrame.NumCrosshairs].Y = y;
+			NextFrame.NumCrosshairs++;
+		}
+
+		return;
+	}
+#endif
+
+	DrawCrosshair(crosshair, fgcolor, bgcolor, x, y, IPPU.DoubleWidthPixels, IPPU.DoubleHeightPixels, PPU.ScreenHeight);
+}
+
+static void DrawCrosshair (const char *crosshair, uint8 fgcolor, uint8 bgcolor, int16 x, int16 y, bool8 doublewidth, bool8 doubleheight, int height)
+{
+	int16	r, rx = 1, c, cx = 1, W = SNES_WIDTH, H = height;
 	uint16	fg, bg;
 
+	ForgetLines(0, MAX_SNES_HEIGHT - 1);
+
 	x -= 7;
 	y -= 7;
 
-	if (IPPU.DoubleWidthPixels)  { cx = 2; x *= 2; W *= 2; }
-	if (IPPU.DoubleHeightPixels) { rx = 2; y *= 2; H *= 2; }
+	if (doublewidth)  { cx = 2; x *= 2; W *= 2; }
+	if (doubleheight) { rx = 2; y *= 2; H *= 2; }
 
 	fg = get_crosshair_color(fgcolor);
 	bg = get_crosshair_color(bgcolor);
@@ -2185,3 +2891,4 @@ void S9xDrawCrosshair (const char *crosshair, uint8 fgcolor, uint8 bgcolor, int1
 	}
 }
 
+#endif
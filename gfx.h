@@ -10,6 +10,8 @@
 #include "port.h"
 #include <vector>
 
+#define COMPOSITE_LINES	16	// lines drawn into the layer buffers at a time
+
 struct SGFX
 {
 	const uint32 Pitch = sizeof(uint16) * MAX_SNES_WIDTH;
@@ -22,6 +24,7 @@ struct SGFX
 	uint8	*SubZBuffer;
 	uint16	*S;
 	uint8	*DB;
+	uint8	*MB;				// colour math flags, when drawing into a layer buffer
 	uint16	*ZERO;
 	uint32	PPL;				// number of pixels on each of Screen buffer
 	uint32	LinesPerTile;		// number of lines in 1 tile (4 or 8 due to interlace)
@@ -63,6 +66,23 @@ struct SGFX
 	void	(*DrawMode7BG1Nomath) (uint32, uint32, int);
 	void	(*DrawMode7BG2Math) (uint32, uint32, int);
 	void	(*DrawMode7BG2Nomath) (uint32, uint32, int);
+	void	(*CompositeLine) (uint32, uint16 *, uint8 *);
+
+	// Settings.LayerCompositor draws each layer into its own buffer, then
+	// merges them a line at a time. Index as for Clip: BG1-4, OBJ, backdrop.
+	struct
+	{
+		uint16	Colour[COMPOSITE_LINES * SNES_WIDTH];
+		uint8	Depth[COMPOSITE_LINES * SNES_WIDTH];
+		uint8	Math[COMPOSITE_LINES * SNES_WIDTH];
+	}	Layer[6];
+	uint32	LayersDrawn;
+	bool8	Compositing;
+
+	// Settings.ReuseLines: a hash of everything each row of Screen was drawn
+	// from, or 0 if the row has been drawn over since. A row whose hash is the
+	// same after a frame as before it was kept, not drawn again.
+	uint64	LineHash[MAX_SNES_HEIGHT];
 
 	std::string InfoString;
 	uint32	InfoStringTimeout;
@@ -128,6 +148,23 @@ extern struct SGFX	GFX;
 #define V_FLIP		0x8000
 #define BLANK_TILE	2
 
+#ifdef HAVE_SSE2
+// Adds each of red, green and blue of eight pixels at a time, capping them at Max.
+static alwaysinline __m128i COLOR_ADD_CAPPED8 (__m128i C1, __m128i C2, __m128i Max)
+{
+	const __m128i	mask = _mm_set1_epi16(0x1f);
+
+	__m128i	r = _mm_min_epi16(_mm_add_epi16(_mm_and_si128(_mm_srli_epi16(C1, RED_SHIFT_BITS),   mask), _mm_and_si128(_mm_srli_epi16(C2, RED_SHIFT_BITS),   mask)), Max);
+	__m128i	g = _mm_min_epi16(_mm_add_epi16(_mm_and_si128(_mm_srli_epi16(C1, GREEN_SHIFT_BITS), mask), _mm_and_si128(_mm_srli_epi16(C2, GREEN_SHIFT_BITS), mask)), Max);
+	__m128i	b = _mm_min_epi16(_mm_add_epi16(_mm_and_si128(C1, mask), _mm_and_si128(C2, mask)), Max);
+	__m128i	C = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, RED_SHIFT_BITS), _mm_slli_epi16(g, GREEN_SHIFT_BITS)), b);
+#if GREEN_SHIFT_BITS == 6
+	C = _mm_or_si128(C, _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0x10)), 1));
+#endif
+	return C;
+}
+#endif
+
 struct COLOR_ADD
 {
 	static alwaysinline uint16 fn(uint16 C1, uint16 C2)
@@ -154,6 +191,24 @@ struct COLOR_ADD
 			(C2 & RGB_REMOVE_LOW_BITS_MASK)) >> 1) +
 			(C1 & C2 & RGB_LOW_BITS_MASK)) | ALPHA_BITS_MASK;
 	}
+
+#ifdef HAVE_SSE2
+	// The same on eight pixels at a time
+	static alwaysinline __m128i fn8(__m128i C1, __m128i C2)
+	{
+		return COLOR_ADD_CAPPED8(C1, C2, _mm_set1_epi16(0x1f));
+	}
+
+	static alwaysinline __m128i fn1_2_8(__m128i C1, __m128i C2)
+	{
+		const __m128i	low = _mm_set1_epi16(RGB_LOW_BITS_MASK);
+
+		// Both halves are exact with the low bits removed, so the sum can't overflow
+		return _mm_or_si128(_mm_add_epi16(_mm_add_epi16(_mm_srli_epi16(_mm_andnot_si128(low, C1), 1),
+			_mm_srli_epi16(_mm_andnot_si128(low, C2), 1)),
+			_mm_and_si128(_mm_and_si128(C1, C2), low)), _mm_set1_epi16(ALPHA_BITS_MASK));
+	}
+#endif
 };
 
 struct COLOR_ADD_BRIGHTNESS
@@ -173,6 +228,18 @@ struct COLOR_ADD_BRIGHTNESS
 	{
 		return COLOR_ADD::fn1_2(C1, C2);
 	}
+
+#ifdef HAVE_SSE2
+	static alwaysinline __m128i fn8(__m128i C1, __m128i C2)
+	{
+		return COLOR_ADD_CAPPED8(C1, C2, _mm_set1_epi16(brightness_cap[63]));
+	}
+
+	static alwaysinline __m128i fn1_2_8(__m128i C1, __m128i C2)
+	{
+		return COLOR_ADD::fn1_2_8(C1, C2);
+	}
+#endif
 };
 
 
@@ -198,6 +265,42 @@ struct COLOR_SUB
 		return GFX.ZERO[((C1 | RGB_HI_BITS_MASKx2) -
 			(C2 & RGB_REMOVE_LOW_BITS_MASK)) >> 1];
 	}
+
+#ifdef HAVE_SSE2
+	static alwaysinline __m128i fn8(__m128i C1, __m128i C2)
+	{
+		const __m128i	red   = _mm_set1_epi16((int16) FIRST_COLOR_MASK);
+		const __m128i	green = _mm_set1_epi16(SECOND_COLOR_MASK);
+		const __m128i	blue  = _mm_set1_epi16(THIRD_COLOR_MASK);
+
+		// Green is subtracted with its low bit, like fn() does
+		__m128i	C = _mm_or_si128(_mm_or_si128(_mm_subs_epu16(_mm_and_si128(C1, red), _mm_and_si128(C2, red)),
+			_mm_and_si128(_mm_subs_epu16(_mm_and_si128(C1, green), _mm_and_si128(C2, green)), _mm_set1_epi16(0x1f << GREEN_SHIFT_BITS))),
+			_mm_subs_epu16(_mm_and_si128(C1, blue), _mm_and_si128(C2, blue)));
+	#if GREEN_SHIFT_BITS == 6
+		C = _mm_or_si128(C, _mm_srli_epi16(_mm_and_si128(C, _mm_set1_epi16(0x0400)), 5));
+	#endif
+		return C;
+	}
+
+	static alwaysinline __m128i fn1_2_8(__m128i C1, __m128i C2)
+	{
+		// The GFX.ZERO index, halved before subtracting so it stays within 16 bits
+		__m128i	i = _mm_sub_epi16(_mm_or_si128(_mm_srli_epi16(C1, 1), _mm_set1_epi16((int16) RGB_HI_BITS_MASK)),
+			_mm_srli_epi16(_mm_andnot_si128(_mm_set1_epi16(RGB_LOW_BITS_MASK), C2), 1));
+
+		// GFX.ZERO keeps a colour without its top bit if that was set, or else zeroes it
+		#define ZERO_COLOR8(FIELD, HI) \
+			_mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(i, _mm_set1_epi16((int16) (HI))), _mm_set1_epi16((int16) (HI))), \
+				_mm_and_si128(i, _mm_set1_epi16((int16) ((FIELD) & ~(HI)))))
+
+		__m128i	C = _mm_or_si128(_mm_or_si128(ZERO_COLOR8(FIRST_COLOR_MASK, RED_HI_BIT_MASK),
+			ZERO_COLOR8(SECOND_COLOR_MASK, GREEN_HI_BIT_MASK)), ZERO_COLOR8(THIRD_COLOR_MASK, BLUE_HI_BIT_MASK));
+
+		#undef ZERO_COLOR8
+		return C;
+	}
+#endif
 };
 
 void S9xStartScreenRefresh (void);
@@ -209,6 +312,18 @@ void S9xDisplayChar (uint16 *, uint8);
 void S9xGraphicsScreenResize (void);
 // called automatically unless Settings.AutoDisplayMessages is false
 void S9xDisplayMessages (uint16 *, int, int, int, int);
+// converts a rendered 16-bit image to 32-bit 0x00RRGGBB, pitches in bytes
+void S9xConvertToXRGB8888 (const uint16 *, int, uint32 *, int, int, int);
+
+#ifdef ALLOW_RENDER_THREADS
+// used instead of drawing in S9xUpdateScreen() when Settings.RenderThreads is non-zero or Settings.RenderPipeline is set
+void S9xQueueScreenUpdate (uint32, bool8);
+bool8 S9xScreenUpdatesQueued (void);
+void S9xDrawQueuedScreenUpdates (void);
+void S9xStartQueuedScreenUpdates (void);
+void S9xWaitForScreenUpdates (void);
+void S9xStopRenderThreads (void);
+#endif
 
 // external port interface which must be implemented or initialised for each port
 bool8 S9xGraphicsInit (void);
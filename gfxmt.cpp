@@ -0,0 +1,564 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// Threaded screen drawing.
+//
+// When Settings.RenderThreads is non-zero, S9xUpdateScreen() doesn't draw the
+// lines it is handed. Instead the state the renderer reads (PPU registers,
+// palette, OAM, sprite line lists, and a copy of VRAM whenever it changed) is
+// queued as a band, and at the end of the frame the bands are cut into runs of
+// lines which are drawn in parallel. Every line only depends on its own band,
+// so the result is the same as drawing them one after the other.
+//
+// With Settings.RenderPipeline the bands are queued the same way, but a frame
+// is drawn on a separate thread while the next one is emulated, and gfx.cpp
+// shows it one frame later. The queue is double-buffered for that.
+//
+// The drawing code is gfx.cpp, tile.cpp and the tileimpl files compiled a
+// second time inside the ThreadedGFX namespace, with GFX, IPPU, PPU, Memory
+// and BG pointing to per-thread copies, in the same way sa1cpu.cpp reuses
+// cpuops.cpp.
+
+#ifdef ALLOW_RENDER_THREADS
+
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include "snes9x.h"
+#include "memmap.h"
+#include "ppu.h"
+#include "tile.h"
+#include "controls.h"
+#include "crosshairs.h"
+#include "cheats.h"
+#include "movie.h"
+#include "screenshot.h"
+#include "display.h"
+
+extern struct SLineData			LineData[240];
+extern struct SLineMatrixData	LineMatrixData[240];
+
+struct SRenderBand
+{
+	uint32	StartY;
+	uint32	EndY;
+	uint32	PPL;
+	uint32	WidenPPL;		// lines above StartY must be doubled in width first
+	bool8	Deepen;			// ... or in height
+	uint8	DoInterlace;
+	uint32	FixedColour;
+	uint8	*VRAM;
+	uint32	VRAMVersion;
+	uint8	FillRAM[0x100];	// $2100-$21ff
+	uint8	OBJWidths[128];
+	uint8	OBJVisibleTiles[128];
+	struct SPPU			PPURegs;
+	struct InternalPPU	IPPURegs;
+};
+
+struct SRenderQueue
+{
+	std::vector<struct SRenderBand>		Bands;
+	uint32								NumBands;
+	std::vector<std::vector<uint8> >	VRAM;
+	uint32								NumVRAM;
+	decltype(SGFX::OBJLines)			OBJLines;
+};
+
+struct SRenderJob
+{
+	const struct SRenderQueue	*Queue;
+	const struct SRenderBand	*Band;
+	uint32						StartY;
+	uint32						EndY;
+};
+
+struct SRenderContext
+{
+	struct SGFX			GFX;
+	struct InternalPPU	IPPU;
+	const struct SPPU	*PPURegs;
+
+	struct
+	{
+		uint8	*VRAM;
+		uint8	FillRAM[0x2200];
+	}	Memory;
+
+	uint16	DirectColourMaps[8][256];
+	uint8	BrightnessCap[64];
+	uint8	*ColourXB;
+	uint32	VRAMVersion;
+	uint8	*TileCache[7];
+	uint8	*TileCached[7];
+
+	std::vector<struct SRenderJob>	Jobs;
+	std::thread						Thread;
+};
+
+static const uint32	TileCacheSize[7] =
+{
+	MAX_2BIT_TILES, MAX_4BIT_TILES, MAX_8BIT_TILES,
+	MAX_2BIT_TILES, MAX_2BIT_TILES, MAX_4BIT_TILES, MAX_4BIT_TILES
+};
+
+static struct SRenderQueue		Queues[2];
+static struct SRenderQueue		*Queue = &Queues[0];	// the one being filled
+static uint32					VRAMVersion;
+
+static std::vector<struct SRenderContext *>	Contexts;	// [0] is the thread drawing the queue
+static std::thread							PipelineThread;
+static struct SRenderQueue					*PipelineQueue;
+static std::mutex							Mutex;
+static std::condition_variable				StartCond;
+static std::condition_variable				DoneCond;
+static uint32								Generation;
+static uint32								Pending;
+static bool									Quit;
+
+namespace ThreadedGFX
+{
+	static thread_local struct SRenderContext	*Context;
+	static thread_local struct SBG				BG;
+	static struct SLineData						LineData[240];
+	static struct SLineMatrixData				LineMatrixData[240];
+
+	#define GFX					(Context->GFX)
+	#define IPPU				(Context->IPPU)
+	#define PPU					(*Context->PPURegs)
+	#define Memory				(Context->Memory)
+	#define DirectColourMaps	(Context->DirectColourMaps)
+	#define brightness_cap		(Context->BrightnessCap)
+
+	static inline bool S9xInterlaceField (void)
+	{
+		return ((Memory.FillRAM[0x213F] & 0x80) >> 7);
+	}
+
+	// Same as the one in gfx.h, but with the thread's brightness_cap.
+	struct COLOR_ADD_BRIGHTNESS
+	{
+		static alwaysinline uint16 fn(uint16 C1, uint16 C2)
+		{
+			return ((brightness_cap[ (C1 >> RED_SHIFT_BITS)           +  (C2 >> RED_SHIFT_BITS)          ] << RED_SHIFT_BITS)   |
+					(brightness_cap[((C1 >> GREEN_SHIFT_BITS) & 0x1f) + ((C2 >> GREEN_SHIFT_BITS) & 0x1f)] << GREEN_SHIFT_BITS) |
+		#if GREEN_SHIFT_BITS == 6
+				   ((brightness_cap[((C1 >> 6) & 0x1f) + ((C2 >> 6) & 0x1f)] & 0x10) << 1) |
+		#endif
+					(brightness_cap[ (C1                      & 0x1f) +  (C2                      & 0x1f)]      ));
+		}
+
+		static alwaysinline uint16 fn1_2(uint16 C1, uint16 C2)
+		{
+			return COLOR_ADD::fn1_2(C1, C2);
+		}
+
+	#ifdef HAVE_SSE2
+		static alwaysinline __m128i fn8(__m128i C1, __m128i C2)
+		{
+			return COLOR_ADD_CAPPED8(C1, C2, _mm_set1_epi16(brightness_cap[63]));
+		}
+
+		static alwaysinline __m128i fn1_2_8(__m128i C1, __m128i C2)
+		{
+			return COLOR_ADD::fn1_2_8(C1, C2);
+		}
+	#endif
+	};
+
+	#define RENDER_THREAD
+	#define _TILEIMPL_CPP_
+	#include "tile.cpp"
+	#include "tileimpl-n1x1.cpp"
+	#include "tileimpl-n2x1.cpp"
+	#include "tileimpl-h2x1.cpp"
+	#include "gfx.cpp"
+	#undef RENDER_THREAD
+
+	static void DrawJob (const struct SRenderJob &job)
+	{
+		const struct SRenderBand	*band = job.Band;
+
+		if (Context->VRAMVersion != band->VRAMVersion)
+		{
+			for (int i = 0; i < 7; i++)
+				memset(Context->TileCached[i], 0, TileCacheSize[i]);
+			Context->VRAMVersion = band->VRAMVersion;
+		}
+
+		Context->PPURegs = &band->PPURegs;
+		IPPU = band->IPPURegs;
+		memcpy(IPPU.TileCache, Context->TileCache, sizeof(IPPU.TileCache));
+		memcpy(IPPU.TileCached, Context->TileCached, sizeof(IPPU.TileCached));
+		Memory.VRAM = band->VRAM;
+		memcpy(&Memory.FillRAM[0x2100], band->FillRAM, sizeof(band->FillRAM));
+
+		if (Context->ColourXB != IPPU.XB)
+		{
+			S9xBuildDirectColourMaps();
+
+			for (int i = 0; i < 64; i++)
+				brightness_cap[i] = (i > IPPU.XB[0x1f]) ? IPPU.XB[0x1f] : i;
+
+			Context->ColourXB = IPPU.XB;
+		}
+
+		GFX.PPL = band->PPL;
+		GFX.DoInterlace = band->DoInterlace;
+		GFX.FixedColour = band->FixedColour;
+		GFX.StartY = job.StartY;
+		GFX.EndY = job.EndY;
+		memcpy(GFX.OBJWidths, band->OBJWidths, sizeof(GFX.OBJWidths));
+		memcpy(GFX.OBJVisibleTiles, band->OBJVisibleTiles, sizeof(GFX.OBJVisibleTiles));
+		memcpy(&GFX.OBJLines[job.StartY], &job.Queue->OBJLines[job.StartY], (job.EndY - job.StartY + 1) * sizeof(GFX.OBJLines[0]));
+
+		// S9xStartScreenRefresh() leaves clearing the depth buffers to us.
+		memset(GFX.ZBuffer + job.StartY * GFX.PPL, 0, (job.EndY - job.StartY + 1) * GFX.PPL);
+		memset(GFX.SubZBuffer + job.StartY * GFX.PPL, 0, (job.EndY - job.StartY + 1) * GFX.PPL);
+
+		RenderLines();
+	}
+
+	static void RunJobs (struct SRenderContext *context)
+	{
+		Context = context;
+
+		for (size_t i = 0; i < context->Jobs.size(); i++)
+			DrawJob(context->Jobs[i]);
+	}
+
+	static void ExpandScreen (const struct SRenderBand &band)
+	{
+		if (band.WidenPPL)
+			DoubleScreenWidth(band.StartY, band.WidenPPL);
+		if (band.Deepen)
+			DoubleScreenHeight(band.StartY);
+	}
+
+	static void WorkerThread (struct SRenderContext *context, uint32 generation)
+	{
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex>	lock(Mutex);
+
+				StartCond.wait(lock, [generation] { return (Quit || Generation != generation); });
+				if (Quit)
+					return;
+				generation = Generation;
+			}
+
+			RunJobs(context);
+
+			{
+				std::lock_guard<std::mutex>	lock(Mutex);
+
+				if (--Pending == 0)
+					DoneCond.notify_all();
+			}
+		}
+	}
+
+	#undef GFX
+	#undef IPPU
+	#undef PPU
+	#undef Memory
+	#undef DirectColourMaps
+	#undef brightness_cap
+}
+
+static bool8 StartRenderThreads (uint32 count)
+{
+	S9xStopRenderThreads();
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		struct SRenderContext	*context = new SRenderContext();
+
+		Contexts.push_back(context);
+
+		for (int t = 0; t < 7; t++)
+		{
+			context->TileCache[t]  = (uint8 *) malloc(TileCacheSize[t] * 64);
+			context->TileCached[t] = (uint8 *) calloc(TileCacheSize[t], 1);
+
+			if (!context->TileCache[t] || !context->TileCached[t])
+			{
+				S9xStopRenderThreads();
+				return (FALSE);
+			}
+		}
+	}
+
+	ThreadedGFX::S9xInitTileRenderer();
+
+	for (uint32 i = 1; i < count; i++)
+		Contexts[i]->Thread = std::thread(ThreadedGFX::WorkerThread, Contexts[i], Generation);
+
+	return (TRUE);
+}
+
+void S9xStopRenderThreads (void)
+{
+	S9xWaitForScreenUpdates();
+
+	{
+		std::lock_guard<std::mutex>	lock(Mutex);
+		Quit = true;
+	}
+
+	StartCond.notify_all();
+
+	if (PipelineThread.joinable())
+		PipelineThread.join();
+
+	for (size_t i = 0; i < Contexts.size(); i++)
+	{
+		struct SRenderContext	*context = Contexts[i];
+
+		if (context->Thread.joinable())
+			context->Thread.join();
+
+		for (int t = 0; t < 7; t++)
+		{
+			free(context->TileCache[t]);
+			free(context->TileCached[t]);
+		}
+
+		delete context;
+	}
+
+	Contexts.clear();
+	Quit = false;
+}
+
+void S9xQueueScreenUpdate (uint32 widen_ppl, bool8 deepen)
+{
+	if (Queue->NumBands == Queue->Bands.size())
+		Queue->Bands.resize(Queue->NumBands + 1);
+
+	struct SRenderBand	&band = Queue->Bands[Queue->NumBands++];
+
+	if (IPPU.VRAMChanged || !Queue->NumVRAM)
+	{
+		if (Queue->NumVRAM == Queue->VRAM.size())
+			Queue->VRAM.push_back(std::vector<uint8>(0x10000));
+
+		memcpy(Queue->VRAM[Queue->NumVRAM++].data(), Memory.VRAM, 0x10000);
+
+		// A frame's first copy of unchanged VRAM keeps the tiles the threads have cached.
+		if (IPPU.VRAMChanged)
+			VRAMVersion++;
+		IPPU.VRAMChanged = FALSE;
+	}
+
+	band.StartY = GFX.StartY;
+	band.EndY = GFX.EndY;
+	band.PPL = GFX.PPL;
+	band.WidenPPL = widen_ppl;
+	band.Deepen = deepen;
+	band.DoInterlace = GFX.DoInterlace;
+	band.FixedColour = GFX.FixedColour;
+	band.VRAM = Queue->VRAM[Queue->NumVRAM - 1].data();
+	band.VRAMVersion = VRAMVersion;
+	memcpy(band.FillRAM, &Memory.FillRAM[0x2100], sizeof(band.FillRAM));
+	memcpy(band.OBJWidths, GFX.OBJWidths, sizeof(band.OBJWidths));
+	memcpy(band.OBJVisibleTiles, GFX.OBJVisibleTiles, sizeof(band.OBJVisibleTiles));
+	band.PPURegs = PPU;
+	band.IPPURegs = IPPU;
+
+	if (band.StartY <= band.EndY)
+		memcpy(&Queue->OBJLines[band.StartY], &GFX.OBJLines[band.StartY], (band.EndY - band.StartY + 1) * sizeof(GFX.OBJLines[0]));
+}
+
+static bool8 CanSplitBand (const struct SRenderBand &band, uint32 y)
+{
+	// A mosaic block is drawn with the offsets of its first line, so a band
+	// may only be cut where the full band would have started a block anyway.
+	uint32	size = band.PPURegs.Mosaic;
+
+	if (size <= 1)
+		return (TRUE);
+
+	return (((uint32) band.StartY - band.PPURegs.MosaicStart) % size + y - band.StartY) % size == 0 &&
+		(y - band.PPURegs.MosaicStart) % size == 0;
+}
+
+static void AssignJobs (const struct SRenderQueue *queue, uint32 threads)
+{
+	uint32	lines = 0, done = 0;
+
+	for (uint32 i = 0; i < queue->NumBands; i++)
+		if (queue->Bands[i].StartY <= queue->Bands[i].EndY)
+			lines += queue->Bands[i].EndY - queue->Bands[i].StartY + 1;
+
+	uint32	share = (lines + threads - 1) / threads;
+
+	for (uint32 i = 0; i < queue->NumBands; i++)
+	{
+		const struct SRenderBand	&band = queue->Bands[i];
+
+		for (uint32 y = band.StartY; y <= band.EndY;)
+		{
+			uint32	thread = std::min(done / share, threads - 1);
+			uint32	end = band.EndY;
+
+			if (thread < threads - 1)
+			{
+				uint32	next = y + (thread + 1) * share - done;
+
+				while (next <= band.EndY && !CanSplitBand(band, next))
+					next++;
+
+				if (next <= band.EndY)
+					end = next - 1;
+			}
+
+			struct SRenderJob	job = { queue, &band, y, end };
+			Contexts[thread]->Jobs.push_back(job);
+
+			done += end - y + 1;
+			y = end + 1;
+		}
+	}
+}
+
+static bool8 PrepareJobs (void)
+{
+	// The queue is drawn even if threading was switched off mid-frame.
+	uint32	threads = Settings.RenderThreads ? Settings.RenderThreads : 1;
+
+	if (Contexts.size() != threads && !StartRenderThreads(threads))
+	{
+		Settings.RenderThreads = 0;
+		Settings.RenderPipeline = FALSE;
+		Queue->NumBands = 0;
+		Queue->NumVRAM = 0;
+		S9xMessage(S9X_ERROR, S9X_NO_INFO, "Not enough memory for render threads.");
+		return (FALSE);
+	}
+
+	memcpy(ThreadedGFX::LineData, LineData, sizeof(LineData));
+	memcpy(ThreadedGFX::LineMatrixData, LineMatrixData, sizeof(LineMatrixData));
+
+	for (uint32 i = 0; i < threads; i++)
+	{
+		struct SRenderContext	*context = Contexts[i];
+
+		context->GFX.Screen = GFX.Screen;
+		context->GFX.SubScreen = GFX.SubScreen;
+		context->GFX.ZBuffer = GFX.ZBuffer;
+		context->GFX.SubZBuffer = GFX.SubZBuffer;
+		context->GFX.ZERO = GFX.ZERO;
+		context->Jobs.clear();
+	}
+
+	AssignJobs(Queue, threads);
+
+	return (TRUE);
+}
+
+static void DrawJobs (struct SRenderQueue *queue)
+{
+	{
+		std::lock_guard<std::mutex>	lock(Mutex);
+		Generation++;
+		Pending = Contexts.size() - 1;
+	}
+
+	StartCond.notify_all();
+
+	ThreadedGFX::RunJobs(Contexts[0]);
+
+	{
+		std::unique_lock<std::mutex>	lock(Mutex);
+		DoneCond.wait(lock, [] { return (Pending == 0); });
+	}
+
+	// Going hires or interlaced mid-frame stretches the lines drawn so far.
+	// Those are untouched by later bands, so it's safe to do it afterwards.
+	for (uint32 i = 0; i < queue->NumBands; i++)
+		ThreadedGFX::ExpandScreen(queue->Bands[i]);
+
+	queue->NumBands = 0;
+	queue->NumVRAM = 0;
+}
+
+static void PipelineLoop (void)
+{
+	for (;;)
+	{
+		struct SRenderQueue	*queue;
+
+		{
+			std::unique_lock<std::mutex>	lock(Mutex);
+
+			StartCond.wait(lock, [] { return (Quit || PipelineQueue); });
+			if (Quit)
+				return;
+			queue = PipelineQueue;
+		}
+
+		DrawJobs(queue);
+
+		{
+			std::lock_guard<std::mutex>	lock(Mutex);
+			PipelineQueue = NULL;
+		}
+
+		DoneCond.notify_all();
+	}
+}
+
+bool8 S9xScreenUpdatesQueued (void)
+{
+	return (Queue->NumBands != 0);
+}
+
+void S9xDrawQueuedScreenUpdates (void)
+{
+	if (!Queue->NumBands)
+		return;
+
+	S9xWaitForScreenUpdates();
+
+	if (PrepareJobs())
+		DrawJobs(Queue);
+}
+
+void S9xStartQueuedScreenUpdates (void)
+{
+	if (!Queue->NumBands)
+		return;
+
+	S9xWaitForScreenUpdates();
+
+	if (!PrepareJobs())
+		return;
+
+	if (!PipelineThread.joinable())
+		PipelineThread = std::thread(PipelineLoop);
+
+	{
+		std::lock_guard<std::mutex>	lock(Mutex);
+		PipelineQueue = Queue;
+	}
+
+	StartCond.notify_all();
+
+	Queue = (Queue == &Queues[0]) ? &Queues[1] : &Queues[0];
+}
+
+void S9xWaitForScreenUpdates (void)
+{
+	std::unique_lock<std::mutex>	lock(Mutex);
+	DoneCond.wait(lock, [] { return (!PipelineQueue); });
+}
+
+#endif
@@ -76,6 +76,8 @@ static retro_input_state_t input_state_cb = NULL;
 static snes_ntsc_t *snes_ntsc = NULL;
 static int blargg_filter = 0;
 static uint16 *ntsc_screen_buffer, *snes_ntsc_buffer;
+static bool xrgb8888_output = false;
+static uint32 *xrgb8888_buffer;
 
 const int MAX_SNES_WIDTH_NTSC = ((SNES_NTSC_OUT_WIDTH(256) + 3) / 4) * 4;
 
@@ -419,6 +421,35 @@ static void update_variables(void)
         }
     }
 
+#ifdef ALLOW_RENDER_THREADS
+    Settings.RenderThreads = 0;
+    var.key="snes9x_render_threads";
+    var.value=NULL;
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+        Settings.RenderThreads = atoi(var.value);
+
+    Settings.RenderPipeline = FALSE;
+    var.key="snes9x_render_pipeline";
+    var.value=NULL;
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+        if (strcmp(var.value, "enabled") == 0)
+            Settings.RenderPipeline = TRUE;
+#endif
+
+    Settings.LayerCompositor = FALSE;
+    var.key="snes9x_layer_compositor";
+    var.value=NULL;
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+        if (strcmp(var.value, "enabled") == 0)
+            Settings.LayerCompositor = TRUE;
+
+    Settings.ReuseLines = FALSE;
+    var.key="snes9x_reuse_lines";
+    var.value=NULL;
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+        if (strcmp(var.value, "enabled") == 0)
+            Settings.ReuseLines = TRUE;
+
     Settings.MaxSpriteTilesPerLine = 34;
     var.key="snes9x_reduce_sprite_flicker";
     var.value=NULL;
@@ -1096,6 +1127,40 @@ static bool8 is_SufamiTurbo_Cart (const uint8 *data, uint32 size)
         return (FALSE);
 }
 
+static bool set_pixel_format(void)
+{
+    struct retro_variable var;
+    enum retro_pixel_format fmt;
+
+    if (!environ_cb)
+        return false;
+
+    /* The frontend only takes a new pixel format while a game is loading */
+    xrgb8888_output = false;
+    var.key = "snes9x_xrgb8888_output";
+    var.value = NULL;
+
+    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value && !strcmp(var.value, "enabled"))
+    {
+        fmt = RETRO_PIXEL_FORMAT_XRGB8888;
+        if (environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
+        {
+            xrgb8888_output = true;
+            return true;
+        }
+    }
+
+    /* If we're in RGB565 format, switch frontend to that */
+    if (RED_SHIFT_BITS == 11)
+    {
+        fmt = RETRO_PIXEL_FORMAT_RGB565;
+        if (!environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
+            return false;
+    }
+
+    return true;
+}
+
 bool retro_load_game(const struct retro_game_info *game)
 {
     init_descriptors();
@@ -1133,15 +1198,8 @@ bool retro_load_game(const struct retro_game_info *game)
 
     if (rom_loaded)
     {
-        /* If we're in RGB565 format, switch frontend to that */
-        if (RED_SHIFT_BITS == 11)
-        {
-            enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
-            if (!environ_cb || !environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
-            {
-                return false;
-            }
-        }
+        if (!set_pixel_format())
+            return false;
 
         g_geometry_update = true;
 
@@ -1280,12 +1338,8 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info *i
 
     if (rom_loaded)
     {
-        if(RED_SHIFT_BITS == 11)
-        {
-            enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
-            if (!environ_cb || !environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
-                return false;
-        }
+        if (!set_pixel_format())
+            return false;
 
         g_geometry_update = true;
     }
@@ -1372,6 +1426,7 @@ void retro_init(void)
 
     ntsc_screen_buffer = (uint16*) calloc(1, MAX_SNES_WIDTH_NTSC * 2 * (MAX_SNES_HEIGHT + 16));
     snes_ntsc_buffer = ntsc_screen_buffer + (MAX_SNES_WIDTH_NTSC >> 1) * 16;
+    xrgb8888_buffer = (uint32*) calloc(MAX_SNES_WIDTH_NTSC * MAX_SNES_HEIGHT, sizeof(uint32));
     S9xGraphicsInit();
 
     S9xInitInputDevices();
@@ -1837,11 +1892,14 @@ void retro_run()
         bool audioEnabled = 0 != (result & 2);
         bool videoEnabled = 0 != (result & 1);
         IPPU.RenderThisFrame = videoEnabled;
+        /* Frames nobody will see skip the drawing side of the PPU entirely */
+        Settings.Headless = !videoEnabled;
         S9xSetSoundMute(!audioEnabled);
     }
     else
     {
         IPPU.RenderThisFrame = true;
+        Settings.Headless = FALSE;
         S9xSetSoundMute(false);
     }
 
@@ -1859,6 +1917,7 @@ void retro_deinit()
 
     free(screen_buffer);
     free(ntsc_screen_buffer);
+    free(xrgb8888_buffer);
 }
 
 
@@ -1969,6 +2028,17 @@ bool retro_unserialize(const void* data, size_t size)
     return true;
 }
 
+static void video_refresh(const uint16 *data, int width, int height, int pitch)
+{
+    if (xrgb8888_output)
+    {
+        S9xConvertToXRGB8888(data, pitch, xrgb8888_buffer, MAX_SNES_WIDTH_NTSC * 4, width, height);
+        video_cb(xrgb8888_buffer, width, height, MAX_SNES_WIDTH_NTSC * 4);
+    }
+    else
+        video_cb(data, width, height, pitch);
+}
+
 bool8 S9xDeinitUpdate(int width, int height)
 {
     static int burst_phase = 0;
@@ -2019,7 +2089,7 @@ bool8 S9xDeinitUpdate(int width, int height)
         else
             snes_ntsc_blit(snes_ntsc, GFX.Screen, GFX.Pitch / 2, burst_phase, width, height, snes_ntsc_buffer, MAX_SNES_WIDTH_NTSC * 2);
 
-        video_cb(snes_ntsc_buffer + ((int)(MAX_SNES_WIDTH_NTSC) * overscan_offset), SNES_NTSC_OUT_WIDTH(256), height, MAX_SNES_WIDTH_NTSC * 2);
+        video_refresh(snes_ntsc_buffer + ((int)(MAX_SNES_WIDTH_NTSC) * overscan_offset), SNES_NTSC_OUT_WIDTH(256), height, MAX_SNES_WIDTH_NTSC * 2);
     }
     else if (width == MAX_SNES_WIDTH && hires_blend)
     {
@@ -2065,11 +2135,14 @@ bool8 S9xDeinitUpdate(int width, int height)
             width >>= 1;
         }
 
-        video_cb(GFX.Screen + ((int)(GFX.Pitch >> 1) * overscan_offset), width, height, GFX.Pitch);
+        /* The blend is written over GFX.Screen, so no row of it can be reused next frame */
+        memset(GFX.LineHash, 0, sizeof(GFX.LineHash));
+
+        video_refresh(GFX.Screen + ((int)(GFX.Pitch >> 1) * overscan_offset), width, height, GFX.Pitch);
     }
     else
     {
-        video_cb(GFX.Screen + ((int)(GFX.Pitch >> 1) * overscan_offset), width, height, GFX.Pitch);
+        video_refresh(GFX.Screen + ((int)(GFX.Pitch >> 1) * overscan_offset), width, height, GFX.Pitch);
     }
 
     return TRUE;
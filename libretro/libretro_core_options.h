@@ -192,6 +192,67 @@ struct retro_core_option_definition option_defs_us[] = {
       },
       "disabled"
    },
+#ifdef ALLOW_RENDER_THREADS
+   {
+      "snes9x_render_threads",
+      "Render Threads",
+      "Draws the screen on several threads at the end of each frame. The picture is the same as with a single thread.",
+      {
+         { "disabled", NULL },
+         { "2",        NULL },
+         { "3",        NULL },
+         { "4",        NULL },
+         { "6",        NULL },
+         { "8",        NULL },
+         { NULL, NULL},
+      },
+      "disabled"
+   },
+   {
+      "snes9x_render_pipeline",
+      "Pipelined Rendering",
+      "Draws each frame on another thread while the next one is emulated. Adds one frame of latency; the frames themselves are unchanged.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL},
+      },
+      "disabled"
+   },
+#endif
+   {
+      "snes9x_layer_compositor",
+      "Layer Compositor",
+      "Draws each background and sprite layer into its own line buffer and merges them afterwards, instead of depth-testing every pixel. Hires lines still use the regular renderer.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL},
+      },
+      "disabled"
+   },
+   {
+      "snes9x_reuse_lines",
+      "Reuse Unchanged Lines",
+      "Keeps a line from the previous frame instead of drawing it again when nothing it is drawn from has changed. Has no effect with render threads.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL},
+      },
+      "disabled"
+   },
+   {
+      "snes9x_xrgb8888_output",
+      "32-bit Video Output (Restart)",
+      "Hands the frontend XRGB8888 frames instead of RGB565, converting each frame once in the core. Takes effect when content is loaded.",
+      {
+         { "disabled", NULL },
+         { "enabled",  NULL },
+         { NULL, NULL},
+      },
+      "disabled"
+   },
    {
       "snes9x_reduce_sprite_flicker",
       "Reduce Flickering (Hack, Unsafe)",
@@ -18,6 +18,12 @@ STREAM audioStream = NULL;
 uint32 audioLoopPos;
 size_t partial_frames;
 
+// PCM read-ahead buffer, holds the track bytes [audioBufferStart, audioBufferStart + audioBufferFill)
+#define MSU1_AUDIO_BUFFER_SIZE	16384
+static uint8 audioBuffer[MSU1_AUDIO_BUFFER_SIZE];
+static uint32 audioBufferStart;
+static uint32 audioBufferFill;
+
 // Sample buffer
 static Resampler *msu_resampler = NULL;
 
@@ -103,6 +109,39 @@ static void AudioClose()
 		CLOSE_STREAM(audioStream);
 		audioStream = NULL;
 	}
+
+	audioBufferStart = 0;
+	audioBufferFill = 0;
+}
+
+// Moves the read position to pos, only touching the stream if pos is outside the buffered range
+static void AudioSeek(uint32 pos)
+{
+	MSU1.MSU1_AUDIO_POS = pos;
+
+	if (pos >= audioBufferStart && pos < audioBufferStart + audioBufferFill)
+		return;
+
+	REVERT_STREAM(audioStream, pos, 0);
+	audioBufferStart = pos;
+	audioBufferFill = 0;
+}
+
+// Makes sure at least one full sample is buffered at MSU1_AUDIO_POS, returns false at end of track
+static bool AudioFillBuffer()
+{
+	uint32 offset = MSU1.MSU1_AUDIO_POS - audioBufferStart;
+
+	if (offset + 4 <= audioBufferFill)
+		return true;
+
+	// keep the partial sample at the end of the buffer, the stream is positioned right behind it
+	uint32 remaining = audioBufferFill - offset;
+	memmove(audioBuffer, audioBuffer + offset, remaining);
+	audioBufferStart = MSU1.MSU1_AUDIO_POS;
+	audioBufferFill = remaining + READ_STREAM((char *)audioBuffer + remaining, MSU1_AUDIO_BUFFER_SIZE - remaining, audioStream);
+
+	return audioBufferFill >= 4;
 }
 
 static bool AudioOpen()
@@ -131,6 +170,8 @@ static bool AudioOpen()
 		audioLoopPos += 8;
 
         MSU1.MSU1_AUDIO_POS = 8;
+		audioBufferStart = 8;
+		audioBufferFill = 0;
 
 		MSU1.MSU1_STATUS &= ~AudioError;
 		return true;
@@ -231,45 +272,36 @@ void S9xMSU1Generate(size_t sample_count)
 	{
 		if (MSU1.MSU1_STATUS & AudioPlaying && audioStream)
 		{
-			int32 sample;
-			int16* left = (int16*)&sample;
-			int16* right = left + 1;
-
-			int bytes_read = READ_STREAM((char *)&sample, 4, audioStream);
-			if (bytes_read == 4)
+			if (AudioFillBuffer())
 			{
-				*left = ((int32)(int16)GET_LE16(left) * MSU1.MSU1_VOLUME / 255);
-				*right = ((int32)(int16)GET_LE16(right) * MSU1.MSU1_VOLUME / 255);
+				uint8 *sample = audioBuffer + (MSU1.MSU1_AUDIO_POS - audioBufferStart);
+				int16 left = ((int32)(int16)GET_LE16(sample) * MSU1.MSU1_VOLUME / 255);
+				int16 right = ((int32)(int16)GET_LE16(sample + 2) * MSU1.MSU1_VOLUME / 255);
 
-				msu_resampler->push_sample(*left, *right);
+				msu_resampler->push_sample(left, right);
 				MSU1.MSU1_AUDIO_POS += 4;
 				partial_frames -= 3204;
 			}
 			else
-			if (bytes_read >= 0)
 			{
 				if (MSU1.MSU1_STATUS & AudioRepeating)
 				{
+					// the loop point is usually still buffered for short loops
 					if (audioLoopPos < MSU1.MSU1_AUDIO_POS)
 					{
-						MSU1.MSU1_AUDIO_POS = audioLoopPos;
+						AudioSeek(audioLoopPos);
 					}
 					else // if the loop point is invalid, revert to start
 					{
-						MSU1.MSU1_AUDIO_POS = 8;
+						AudioSeek(8);
 					}
-					REVERT_STREAM(audioStream, MSU1.MSU1_AUDIO_POS, 0);
 				}
 				else
 				{
 					MSU1.MSU1_STATUS &= ~(AudioPlaying | AudioRepeating);
-					REVERT_STREAM(audioStream, 8, 0);
+					AudioSeek(8);
 				}
 			}
-			else
-			{
-				MSU1.MSU1_STATUS &= ~(AudioPlaying | AudioRepeating);
-			}
 		}
 		else
 		{
@@ -369,7 +401,7 @@ void S9xMSU1WritePort(uint8 port, uint8 byte)
 				MSU1.MSU1_AUDIO_POS = 8;
 			}
 
-            REVERT_STREAM(audioStream, MSU1.MSU1_AUDIO_POS, 0);
+			AudioSeek(MSU1.MSU1_AUDIO_POS);
 		}
 		break;
 	case 6:
@@ -419,8 +451,9 @@ void S9xMSU1PostLoadState(void)
 			audioLoopPos <<= 2;
 			audioLoopPos += 8;
 
-			MSU1.MSU1_AUDIO_POS = savedPosition;
-            REVERT_STREAM(audioStream, MSU1.MSU1_AUDIO_POS, 0);
+			audioBufferStart = 8;
+			audioBufferFill = 0;
+			AudioSeek(savedPosition);
 		}
 		else
 		{
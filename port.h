@@ -159,6 +159,11 @@ void SetInfoDlgColor(unsigned char, unsigned char, unsigned char);
 #define MSB_FIRST
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef FAST_LSB_WORD_ACCESS
 #define READ_WORD(s)		(*(uint16 *) (s))
 #define READ_3WORD(s)		(*(uint32 *) (s) & 0x00ffffff)
@@ -206,6 +206,41 @@ void S9xFixColourBrightness (void)
 	}
 }
 
+void S9xInvalidateDirtyTiles (void)
+{
+	// VRAM writes only mark the 16-byte blocks they touch; every cached tile
+	// built from a marked block, including hires tiles that pair it with the
+	// block before, is dropped here before anything is drawn.
+	for (int w = 0; w < MAX_2BIT_TILES / 32; w++)
+	{
+		uint32	dirty = IPPU.TileDirty[w];
+
+		if (!dirty)
+			continue;
+
+		IPPU.TileDirty[w] = 0;
+		IPPU.VRAMGeneration[w >> 4]++;
+
+		for (uint32 t = w * 32; dirty; t++, dirty >>= 1)
+		{
+			if (!(dirty & 1))
+				continue;
+
+			IPPU.TileCached[TILE_2BIT][t] = FALSE;
+			IPPU.TileCached[TILE_4BIT][t >> 1] = FALSE;
+			IPPU.TileCached[TILE_8BIT][t >> 2] = FALSE;
+			IPPU.TileCached[TILE_2BIT_EVEN][t] = FALSE;
+			IPPU.TileCached[TILE_2BIT_EVEN][(t - 1) & (MAX_2BIT_TILES - 1)] = FALSE;
+			IPPU.TileCached[TILE_2BIT_ODD] [t] = FALSE;
+			IPPU.TileCached[TILE_2BIT_ODD] [(t - 1) & (MAX_2BIT_TILES - 1)] = FALSE;
+			IPPU.TileCached[TILE_4BIT_EVEN][t >> 1] = FALSE;
+			IPPU.TileCached[TILE_4BIT_EVEN][((t >> 1) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+			IPPU.TileCached[TILE_4BIT_ODD] [t >> 1] = FALSE;
+			IPPU.TileCached[TILE_4BIT_ODD] [((t >> 1) - 1) & (MAX_4BIT_TILES - 1)] = FALSE;
+		}
+	}
+}
+
 void S9xSetPPU (uint8 Byte, uint16 Address)
 {
 	// MAP_PPU: $2000-$3FFF
@@ -1756,6 +1791,10 @@ void S9xResetPPUFast (void)
 	memset(IPPU.TileCached[TILE_2BIT_ODD], 0, MAX_2BIT_TILES);
 	memset(IPPU.TileCached[TILE_4BIT_EVEN], 0, MAX_4BIT_TILES);
 	memset(IPPU.TileCached[TILE_4BIT_ODD], 0, MAX_4BIT_TILES);
+	memset(IPPU.TileDirty, 0, sizeof(IPPU.TileDirty));
+	for (int i = 0; i < 8; i++)
+		IPPU.VRAMGeneration[i]++;
+	IPPU.VRAMChanged = TRUE;
 }
 
 void S9xSoftResetPPU (void)
@@ -1902,6 +1941,10 @@ void S9xSoftResetPPU (void)
 	memset(IPPU.TileCached[TILE_2BIT_ODD], 0,  MAX_2BIT_TILES);
 	memset(IPPU.TileCached[TILE_4BIT_EVEN], 0, MAX_4BIT_TILES);
 	memset(IPPU.TileCached[TILE_4BIT_ODD], 0,  MAX_4BIT_TILES);
+	memset(IPPU.TileDirty, 0, sizeof(IPPU.TileDirty));
+	for (int i = 0; i < 8; i++)
+		IPPU.VRAMGeneration[i]++;
+	IPPU.VRAMChanged = TRUE;
 	PPU.VRAMReadBuffer = 0; // XXX: FIXME: anything better?
 	GFX.DoInterlace = 0;
 	IPPU.Interlace = FALSE;
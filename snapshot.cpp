@@ -1172,6 +1172,10 @@ void S9xFreezeToStream (STREAM stream)
 	char	buffer[8192];
 	uint8	*soundsnapshot = new uint8[SPC_SAVE_STATE_BLOCK_SIZE];
 
+	// Headless lines add their range and time over flags only when flushed
+	if (Settings.Headless)
+		FLUSH_REDRAW();
+
 	sprintf(buffer, "%s:%04d\n", SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
 	WRITE_STREAM(buffer, strlen(buffer), stream);
 
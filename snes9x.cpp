@@ -245,6 +245,11 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.AutoDisplayMessages        =  conf.GetBool("Display::MessagesInImage",            true);
 	Settings.InitialInfoStringTimeout   =  conf.GetInt ("Display::MessageDisplayTime",         120);
 	Settings.BilinearFilter             =  conf.GetBool("Display::BilinearFilter",             false);
+	Settings.RenderThreads              =  conf.GetUInt("Display::RenderThreads",              0);
+	Settings.RenderPipeline             =  conf.GetBool("Display::RenderPipeline",             false);
+	Settings.LayerCompositor            =  conf.GetBool("Display::LayerCompositor",            false);
+	Settings.ReuseLines                 =  conf.GetBool("Display::ReuseLines",                 false);
+	Settings.Headless                   =  conf.GetBool("Display::Headless",                   false);
 
 	// Settings
 
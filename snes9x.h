@@ -260,6 +260,11 @@ struct SSettings
 	uint16	DisplayColor;
 	bool8	BilinearFilter;
 	bool	ShowOverscan;
+	uint32	RenderThreads;
+	bool8	RenderPipeline;
+	bool8	LayerCompositor;
+	bool8	ReuseLines;
+	bool8	Headless;
 
 	bool8	Multi;
 	char	CartAName[PATH_MAX + 1];
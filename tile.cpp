@@ -17,6 +17,136 @@ namespace {
 	// Here are the tile converters, selected by S9xSelectTileConverter().
 	// Really, except for the definition of DOBIT and the number of times it is called, they're all the same.
 
+#ifdef HAVE_SSE2
+
+	// SSE2 versions of the converters below. Each plane's row byte is spread
+	// across the 8 pixel bytes of its row, tested against the per-pixel bit in
+	// mask, and shifted into the cache bytes from the highest plane down.
+	// Hires tiles take pixels 0-3 from tp1 and 4-7 from tp2; normal tiles pass
+	// the same pointer twice.
+
+	alwaysinline __m128i ConvertLine (__m128i out, __m128i line, __m128i mask)
+	{
+		return (_mm_sub_epi8(_mm_add_epi8(out, out), _mm_cmpeq_epi8(_mm_and_si128(line, mask), mask)));
+	}
+
+	alwaysinline void ConvertPlane (__m128i &out0, __m128i &out1, __m128i &out2, __m128i &out3, __m128i rows, __m128i mask)
+	{
+		// rows holds (tp1, tp2) byte pairs for lines 0-7
+		__m128i	lo = _mm_unpacklo_epi8(rows, rows);
+		__m128i	hi = _mm_unpackhi_epi8(rows, rows);
+
+		out0 = ConvertLine(out0, _mm_unpacklo_epi16(lo, lo), mask);
+		out1 = ConvertLine(out1, _mm_unpackhi_epi16(lo, lo), mask);
+		out2 = ConvertLine(out2, _mm_unpacklo_epi16(hi, hi), mask);
+		out3 = ConvertLine(out3, _mm_unpackhi_epi16(hi, hi), mask);
+	}
+
+	template<int PLANES>
+	alwaysinline uint8 ConvertPlanes (uint8 *pCache, const uint8 *tp1, const uint8 *tp2, __m128i mask)
+	{
+		const __m128i	even = _mm_set1_epi16(0x00ff);
+		const __m128i	odd  = _mm_set1_epi16((short) 0xff00);
+		__m128i			out0 = _mm_setzero_si128(), out1 = out0, out2 = out0, out3 = out0;
+
+		for (int i = PLANES / 2 - 1; i >= 0; i--)
+		{
+			__m128i	v1 = _mm_loadu_si128((const __m128i *) (tp1 + i * 16));
+			__m128i	v2 = _mm_loadu_si128((const __m128i *) (tp2 + i * 16));
+
+			ConvertPlane(out0, out1, out2, out3, _mm_or_si128(_mm_srli_epi16(v1, 8), _mm_and_si128(v2, odd)), mask);
+			ConvertPlane(out0, out1, out2, out3, _mm_or_si128(_mm_and_si128(v1, even), _mm_slli_epi16(v2, 8)), mask);
+		}
+
+		_mm_storeu_si128((__m128i *) pCache + 0, out0);
+		_mm_storeu_si128((__m128i *) pCache + 1, out1);
+		_mm_storeu_si128((__m128i *) pCache + 2, out2);
+		_mm_storeu_si128((__m128i *) pCache + 3, out3);
+
+		__m128i	any = _mm_or_si128(_mm_or_si128(out0, out1), _mm_or_si128(out2, out3));
+
+		return (_mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xffff ? TRUE : BLANK_TILE);
+	}
+
+	alwaysinline __m128i NormalMask (void)
+	{
+		return _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80);
+	}
+
+	alwaysinline __m128i OddMask (void)
+	{
+		return _mm_set1_epi32(0x01041040);
+	}
+
+	alwaysinline __m128i EvenMask (void)
+	{
+		return _mm_set1_epi32(0x02082080);
+	}
+
+	uint8 ConvertTile2 (uint8 *pCache, uint32 TileAddr, uint32)
+	{
+		uint8	*tp = &Memory.VRAM[TileAddr];
+
+		return (ConvertPlanes<2>(pCache, tp, tp, NormalMask()));
+	}
+
+	uint8 ConvertTile4 (uint8 *pCache, uint32 TileAddr, uint32)
+	{
+		uint8	*tp = &Memory.VRAM[TileAddr];
+
+		return (ConvertPlanes<4>(pCache, tp, tp, NormalMask()));
+	}
+
+	uint8 ConvertTile8 (uint8 *pCache, uint32 TileAddr, uint32)
+	{
+		uint8	*tp = &Memory.VRAM[TileAddr];
+
+		return (ConvertPlanes<8>(pCache, tp, tp, NormalMask()));
+	}
+
+	template<int PLANES>
+	alwaysinline uint8 ConvertTileHires (uint8 *pCache, uint32 TileAddr, uint32 Tile, __m128i mask)
+	{
+		const int	shift = PLANES == 2 ? 4 : 5;
+		uint8		*tp1  = &Memory.VRAM[TileAddr], *tp2;
+
+		// The next tile wraps around within VRAM too
+		if (Tile == 0x3ff)
+			tp2 = &Memory.VRAM[(TileAddr - (0x3ff << shift)) & 0xffff];
+		else
+			tp2 = &Memory.VRAM[(TileAddr + (1 << shift)) & 0xffff];
+
+		uint8	result = ConvertPlanes<PLANES>(pCache, tp1, tp2, mask);
+
+		// Tile 0x3ff pairs with a neighbour its aliases don't share, so leave it uncached
+		if (Tile == 0x3ff)
+			return 0;
+
+		return (result);
+	}
+
+	uint8 ConvertTile2h_odd (uint8 *pCache, uint32 TileAddr, uint32 Tile)
+	{
+		return (ConvertTileHires<2>(pCache, TileAddr, Tile, OddMask()));
+	}
+
+	uint8 ConvertTile4h_odd (uint8 *pCache, uint32 TileAddr, uint32 Tile)
+	{
+		return (ConvertTileHires<4>(pCache, TileAddr, Tile, OddMask()));
+	}
+
+	uint8 ConvertTile2h_even (uint8 *pCache, uint32 TileAddr, uint32 Tile)
+	{
+		return (ConvertTileHires<2>(pCache, TileAddr, Tile, EvenMask()));
+	}
+
+	uint8 ConvertTile4h_even (uint8 *pCache, uint32 TileAddr, uint32 Tile)
+	{
+		return (ConvertTileHires<4>(pCache, TileAddr, Tile, EvenMask()));
+	}
+
+#else
+
 	#define DOBIT(n, i) \
 		if ((pix = *(tp + (n)))) \
 		{ \
@@ -116,10 +246,11 @@ namespace {
 		uint32			non_zero = 0;
 		uint8			line;
 
+		// The next tile wraps around within VRAM too
 		if (Tile == 0x3ff)
-			tp2 = tp1 - (0x3ff << 4);
+			tp2 = &Memory.VRAM[(TileAddr - (0x3ff << 4)) & 0xffff];
 		else
-			tp2 = tp1 + (1 << 4);
+			tp2 = &Memory.VRAM[(TileAddr + (1 << 4)) & 0xffff];
 
 		for (line = 8; line != 0; line--, tp1 += 2, tp2 += 2)
 		{
@@ -134,6 +265,10 @@ namespace {
 			non_zero |= p1 | p2;
 		}
 
+		// Tile 0x3ff pairs with a neighbour its aliases don't share, so leave it uncached
+		if (Tile == 0x3ff)
+			return 0;
+
 		return (non_zero ? TRUE : BLANK_TILE);
 	}
 
@@ -144,10 +279,11 @@ namespace {
 		uint32			non_zero = 0;
 		uint8			line;
 
+		// The next tile wraps around within VRAM too
 		if (Tile == 0x3ff)
-			tp2 = tp1 - (0x3ff << 5);
+			tp2 = &Memory.VRAM[(TileAddr - (0x3ff << 5)) & 0xffff];
 		else
-			tp2 = tp1 + (1 << 5);
+			tp2 = &Memory.VRAM[(TileAddr + (1 << 5)) & 0xffff];
 
 		for (line = 8; line != 0; line--, tp1 += 2, tp2 += 2)
 		{
@@ -164,6 +300,10 @@ namespace {
 			non_zero |= p1 | p2;
 		}
 
+		// Tile 0x3ff pairs with a neighbour its aliases don't share, so leave it uncached
+		if (Tile == 0x3ff)
+			return 0;
+
 		return (non_zero ? TRUE : BLANK_TILE);
 	}
 
@@ -182,10 +322,11 @@ namespace {
 		uint32			non_zero = 0;
 		uint8			line;
 
+		// The next tile wraps around within VRAM too
 		if (Tile == 0x3ff)
-			tp2 = tp1 - (0x3ff << 4);
+			tp2 = &Memory.VRAM[(TileAddr - (0x3ff << 4)) & 0xffff];
 		else
-			tp2 = tp1 + (1 << 4);
+			tp2 = &Memory.VRAM[(TileAddr + (1 << 4)) & 0xffff];
 
 		for (line = 8; line != 0; line--, tp1 += 2, tp2 += 2)
 		{
@@ -200,6 +341,10 @@ namespace {
 			non_zero |= p1 | p2;
 		}
 
+		// Tile 0x3ff pairs with a neighbour its aliases don't share, so leave it uncached
+		if (Tile == 0x3ff)
+			return 0;
+
 		return (non_zero ? TRUE : BLANK_TILE);
 	}
 
@@ -210,10 +355,11 @@ namespace {
 		uint32			non_zero = 0;
 		uint8			line;
 
+		// The next tile wraps around within VRAM too
 		if (Tile == 0x3ff)
-			tp2 = tp1 - (0x3ff << 5);
+			tp2 = &Memory.VRAM[(TileAddr - (0x3ff << 5)) & 0xffff];
 		else
-			tp2 = tp1 + (1 << 5);
+			tp2 = &Memory.VRAM[(TileAddr + (1 << 5)) & 0xffff];
 
 		for (line = 8; line != 0; line--, tp1 += 2, tp2 += 2)
 		{
@@ -230,11 +376,17 @@ namespace {
 			non_zero |= p1 | p2;
 		}
 
+		// Tile 0x3ff pairs with a neighbour its aliases don't share, so leave it uncached
+		if (Tile == 0x3ff)
+			return 0;
+
 		return (non_zero ? TRUE : BLANK_TILE);
 	}
 
 	#undef DOBIT
 
+#endif
+
 } // anonymous namespace
 
 void S9xInitTileRenderer (void)
@@ -306,6 +458,16 @@ extern template struct TileImpl::Renderers<DrawMode7BG1, Normal1x1>;
 extern template struct TileImpl::Renderers<DrawMode7MosaicBG2, Normal1x1>;
 extern template struct TileImpl::Renderers<DrawMode7BG2, Normal1x1>;
 
+extern template struct TileImpl::Renderers<DrawTile16, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawClippedTile16, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawMosaicPixel16, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawBackdrop16, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawMode7MosaicBG1, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawMode7BG1, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawMode7MosaicBG2, Layer1x1>;
+extern template struct TileImpl::Renderers<DrawMode7BG2, Layer1x1>;
+extern template struct TileImpl::Renderers<CompositeLine16, Layer1x1>;
+
 extern template struct TileImpl::Renderers<DrawTile16, Normal2x1>;
 extern template struct TileImpl::Renderers<DrawClippedTile16, Normal2x1>;
 extern template struct TileImpl::Renderers<DrawMosaicPixel16, Normal2x1>;
@@ -346,6 +508,17 @@ void S9xSelectTileRenderers (int BGMode, bool8 sub, bool8 obj)
 	bool8 interlace = obj ? FALSE : IPPU.Interlace;
 	bool8 hires = !sub && (BGMode == 5 || BGMode == 6 || IPPU.PseudoHires);
 
+	if (GFX.Compositing)			// normal width, into the layer buffers
+	{
+		DT     = Renderers<DrawTile16, Layer1x1>::Functions;
+		DCT    = Renderers<DrawClippedTile16, Layer1x1>::Functions;
+		DMP    = Renderers<DrawMosaicPixel16, Layer1x1>::Functions;
+		DB     = Renderers<DrawBackdrop16, Layer1x1>::Functions;
+		DM7BG1 = M7M1 ? Renderers<DrawMode7MosaicBG1, Layer1x1>::Functions : Renderers<DrawMode7BG1, Layer1x1>::Functions;
+		DM7BG2 = M7M2 ? Renderers<DrawMode7MosaicBG2, Layer1x1>::Functions : Renderers<DrawMode7BG2, Layer1x1>::Functions;
+		GFX.LinesPerTile = 8;
+	}
+	else
 	if (!IPPU.DoubleWidthPixels)	// normal width
 	{
 		DT     = Renderers<DrawTile16, Normal1x1>::Functions;
@@ -439,6 +612,7 @@ void S9xSelectTileRenderers (int BGMode, bool8 sub, bool8 obj)
 	GFX.DrawBackdropMath    = DB[i];
 	GFX.DrawMode7BG1Math    = DM7BG1[i];
 	GFX.DrawMode7BG2Math    = DM7BG2[i];
+	GFX.CompositeLine       = Renderers<CompositeLine16, Layer1x1>::Functions[i];
 }
 
 void S9xSelectTileConverter (int depth, bool8 hires, bool8 sub, bool8 mosaic)
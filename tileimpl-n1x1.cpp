@@ -21,6 +21,19 @@ namespace TileImpl {
 	}
 
 
+	template<class MATH, class BPSTART>
+	void Layer1x1Base<MATH, BPSTART>::Draw(int N, int M, uint32 Offset, uint32 OffsetInLine, uint8 Pix, uint8 Z1, uint8 Z2)
+	{
+		(void) OffsetInLine;
+		if (Z1 > GFX.DB[Offset + N] && (M))
+		{
+			GFX.S[Offset + N] = GFX.ScreenColors[Pix];
+			GFX.DB[Offset + N] = Z2;
+			GFX.MB[Offset + N] = LayerMath<MATH>::Flags();
+		}
+	}
+
+
 	// normal width
 	template struct Renderers<DrawTile16, Normal1x1>;
 	template struct Renderers<DrawClippedTile16, Normal1x1>;
@@ -31,4 +44,15 @@ namespace TileImpl {
 	template struct Renderers<DrawMode7MosaicBG2, Normal1x1>;
 	template struct Renderers<DrawMode7BG2, Normal1x1>;
 
+	// normal width, into the layer buffers
+	template struct Renderers<DrawTile16, Layer1x1>;
+	template struct Renderers<DrawClippedTile16, Layer1x1>;
+	template struct Renderers<DrawMosaicPixel16, Layer1x1>;
+	template struct Renderers<DrawBackdrop16, Layer1x1>;
+	template struct Renderers<DrawMode7MosaicBG1, Layer1x1>;
+	template struct Renderers<DrawMode7BG1, Layer1x1>;
+	template struct Renderers<DrawMode7MosaicBG2, Layer1x1>;
+	template struct Renderers<DrawMode7BG2, Layer1x1>;
+	template struct Renderers<CompositeLine16, Layer1x1>;
+
 } // namespace TileImpl
@@ -84,6 +84,23 @@ namespace TileImpl {
 	struct HiresInterlace : public HiresBase<MATH, BPInterlace> {};
 
 
+	// The layer plotter, for Settings.LayerCompositor. Pixels go into the buffer of the layer being drawn,
+	// along with whether colour math applies to them; CompositeLine16 merges the layers afterwards.
+	// The depth test only ever fails where OBJ overlap each other.
+	template<class MATH, class BPSTART>
+	struct Layer1x1Base
+	{
+		enum { Pitch = BPSTART::Pitch };
+		typedef BPSTART bpstart_t;
+		typedef MATH math_t;
+
+		static void Draw(int N, int M, uint32 Offset, uint32 OffsetInLine, uint8 Pix, uint8 Z1, uint8 Z2);
+	};
+
+	template<class MATH>
+	struct Layer1x1 : public Layer1x1Base<MATH, BPProgressive> {};
+
+
 	class CachedTile
 	{
 	public:
@@ -99,13 +116,13 @@ namespace TileImpl {
 			if (Tile & H_FLIP)
 			{
 				pCache = &BG.BufferFlip[TileNumber << 6];
-				if (!BG.BufferedFlip[TileNumber])
+				if (!BG.BufferedFlip[TileNumber] || (Tile & 0x3ff) == 0x3ff)
 					BG.BufferedFlip[TileNumber] = BG.ConvertTileFlip(pCache, TileAddr, Tile & 0x3ff);
 			}
 			else
 			{
 				pCache = &BG.Buffer[TileNumber << 6];
-				if (!BG.Buffered[TileNumber])
+				if (!BG.Buffered[TileNumber] || (Tile & 0x3ff) == 0x3ff)
 					BG.Buffered[TileNumber] = BG.ConvertTile(pCache, TileAddr, Tile & 0x3ff);
 			}
 		}
@@ -139,12 +156,27 @@ namespace TileImpl {
 	};
 
 
+#ifdef HAVE_SSE2
+	// Picks A where Mask is set and B elsewhere
+	static alwaysinline __m128i SELECT8(__m128i Mask, __m128i A, __m128i B)
+	{
+		return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B));
+	}
+#endif
+
 	struct NOMATH
 	{
 		static alwaysinline uint16 Calc(uint16 Main, uint16 Sub, uint8 SD)
 		{
 			return Main;
 		}
+
+	#ifdef HAVE_SSE2
+		static alwaysinline __m128i Calc8(__m128i Main, __m128i Sub, __m128i Fixed, __m128i SD, __m128i Clip)
+		{
+			return Main;
+		}
+	#endif
 	};
 	typedef NOMATH Blend_None;
 
@@ -155,6 +187,14 @@ namespace TileImpl {
 		{
 			return Op::fn(Main, (SD & 0x20) ? Sub : GFX.FixedColour);
 		}
+
+	#ifdef HAVE_SSE2
+		// Eight pixels at a time: SD and Clip are masks of the pixels with SD & 0x20 and GFX.ClipColors set
+		static alwaysinline __m128i Calc8(__m128i Main, __m128i Sub, __m128i Fixed, __m128i SD, __m128i Clip)
+		{
+			return Op::fn8(Main, SELECT8(SD, Sub, Fixed));
+		}
+	#endif
 	};
 	typedef REGMATH<COLOR_ADD> Blend_Add;
 	typedef REGMATH<COLOR_SUB> Blend_Sub;
@@ -167,6 +207,13 @@ namespace TileImpl {
 		{
 			return GFX.ClipColors ? Op::fn(Main, GFX.FixedColour) : Op::fn1_2(Main, GFX.FixedColour);
 		}
+
+	#ifdef HAVE_SSE2
+		static alwaysinline __m128i Calc8(__m128i Main, __m128i Sub, __m128i Fixed, __m128i SD, __m128i Clip)
+		{
+			return SELECT8(Clip, Op::fn8(Main, Fixed), Op::fn1_2_8(Main, Fixed));
+		}
+	#endif
 	};
 	typedef MATHF1_2<COLOR_ADD> Blend_AddF1_2;
 	typedef MATHF1_2<COLOR_SUB> Blend_SubF1_2;
@@ -178,11 +225,77 @@ namespace TileImpl {
 		{
 			return GFX.ClipColors ? REGMATH<Op>::Calc(Main, Sub, SD) : (SD & 0x20) ? Op::fn1_2(Main, Sub) : Op::fn(Main, GFX.FixedColour);
 		}
+
+	#ifdef HAVE_SSE2
+		static alwaysinline __m128i Calc8(__m128i Main, __m128i Sub, __m128i Fixed, __m128i SD, __m128i Clip)
+		{
+			__m128i	full = Op::fn8(Main, SELECT8(SD, Sub, Fixed));
+			return SELECT8(_mm_andnot_si128(Clip, SD), Op::fn1_2_8(Main, Sub), full);
+		}
+	#endif
 	};
 	typedef MATHS1_2<COLOR_ADD> Blend_AddS1_2;
 	typedef MATHS1_2<COLOR_SUB> Blend_SubS1_2;
 	typedef MATHS1_2<COLOR_ADD_BRIGHTNESS> Blend_AddS1_2Brightness;
 
+	// Colour math flags kept per pixel by the layer plotter: bit 0 is set if math applies, bit 1 is GFX.ClipColors.
+	template<class MATH>
+	struct LayerMath
+	{
+		static alwaysinline uint8 Flags() { return 1 | (GFX.ClipColors << 1); }
+	};
+
+	template<>
+	struct LayerMath<NOMATH>
+	{
+		static alwaysinline uint8 Flags() { return 0; }
+	};
+
+	// Colour math over a whole line, on the pixels with LayerMath flags set.
+	template<class MATH>
+	struct MathLine
+	{
+		static void Calc(uint16 *Main, const uint16 *Sub, const uint8 *SD, const uint8 *Flags, int Width)
+		{
+			int	x = 0;
+
+		#ifdef HAVE_SSE2
+			const __m128i	Fixed = _mm_set1_epi16(GFX.FixedColour);
+			const __m128i	sdbit = _mm_set1_epi16(0x2020);
+			const __m128i	mathbit = _mm_set1_epi16(0x0101);
+			const __m128i	clipbit = _mm_set1_epi16(0x0202);
+
+			for (; x + 8 <= Width; x += 8)
+			{
+				__m128i	f = _mm_loadl_epi64((__m128i *) (Flags + x));
+				f = _mm_unpacklo_epi8(f, f);
+
+				__m128i	apply = _mm_cmpeq_epi16(_mm_and_si128(f, mathbit), mathbit);
+				if (!_mm_movemask_epi8(apply))
+					continue;
+
+				__m128i	sd = _mm_loadl_epi64((__m128i *) (SD + x));
+				sd = _mm_cmpeq_epi16(_mm_and_si128(_mm_unpacklo_epi8(sd, sd), sdbit), sdbit);
+
+				__m128i	clip = _mm_cmpeq_epi16(_mm_and_si128(f, clipbit), clipbit);
+				__m128i	main = _mm_loadu_si128((__m128i *) (Main + x));
+				__m128i	sub = _mm_loadu_si128((__m128i *) (Sub + x));
+
+				_mm_storeu_si128((__m128i *) (Main + x), SELECT8(apply, MATH::Calc8(main, sub, Fixed, sd, clip), main));
+			}
+		#endif
+
+			for (; x < Width; x++)
+			{
+				if (Flags[x] & 1)
+				{
+					GFX.ClipColors = Flags[x] >> 1;
+					Main[x] = MATH::Calc(Main[x], Sub[x], SD[x]);
+				}
+			}
+		}
+	};
+
 	template<
 		template<class PIXEL_> class TILE,
 		template<class MATH> class PIXEL
@@ -498,6 +611,96 @@ namespace TileImpl {
 	#undef Z2
 	#undef DRAW_PIXEL
 
+	// Merges one line of the layer buffers for Settings.LayerCompositor.
+	// No two layers share a depth, so the deepest pixel is the one the depth test would have kept.
+	// Pixels no layer drew are left alone, like the depth test leaves them.
+	// Depth is the SubZBuffer line when merging the subscreen, or NULL for the main screen,
+	// which then gets colour math against the subscreen line.
+
+	template<class PIXEL>
+	struct CompositeLine16
+	{
+		typedef void (*call_t)(uint32 Line, uint16 *Screen, uint8 *Depth);
+
+		typedef typename PIXEL::math_t MATH;
+
+		static void Draw(uint32 Line, uint16 *Screen, uint8 *Depth)
+		{
+			uint32	Index = (Line - GFX.StartY) * SNES_WIDTH;
+			uint8	Math[SNES_WIDTH];
+			int		layers[6], n = 0;
+
+			for (int i = 0; i < 6; i++)
+			{
+				if (GFX.LayersDrawn & (1 << i))
+					layers[n++] = i;
+			}
+
+		#ifdef HAVE_SSE2
+			const __m128i	zero = _mm_setzero_si128();
+
+			for (int x = 0; x < SNES_WIDTH; x += 16)
+			{
+				__m128i	z = zero;
+
+				for (int i = 0; i < n; i++)
+					z = _mm_max_epu8(z, _mm_loadu_si128((__m128i *) (GFX.Layer[layers[i]].Depth + Index + x)));
+
+				__m128i	none = _mm_cmpeq_epi8(z, zero);
+				__m128i	lo   = _mm_and_si128(_mm_loadu_si128((__m128i *) (Screen + x)),     _mm_unpacklo_epi8(none, none));
+				__m128i	hi   = _mm_and_si128(_mm_loadu_si128((__m128i *) (Screen + x + 8)), _mm_unpackhi_epi8(none, none));
+				__m128i	math = zero;
+
+				for (int i = 0; i < n; i++)
+				{
+					__m128i	m = _mm_andnot_si128(none, _mm_cmpeq_epi8(z, _mm_loadu_si128((__m128i *) (GFX.Layer[layers[i]].Depth + Index + x))));
+
+					lo   = _mm_or_si128(lo,   _mm_and_si128(_mm_unpacklo_epi8(m, m), _mm_loadu_si128((__m128i *) (GFX.Layer[layers[i]].Colour + Index + x))));
+					hi   = _mm_or_si128(hi,   _mm_and_si128(_mm_unpackhi_epi8(m, m), _mm_loadu_si128((__m128i *) (GFX.Layer[layers[i]].Colour + Index + x + 8))));
+					math = _mm_or_si128(math, _mm_and_si128(m, _mm_loadu_si128((__m128i *) (GFX.Layer[layers[i]].Math + Index + x))));
+				}
+
+				_mm_storeu_si128((__m128i *) (Screen + x), lo);
+				_mm_storeu_si128((__m128i *) (Screen + x + 8), hi);
+				_mm_storeu_si128((__m128i *) (Math + x), math);
+				if (Depth)
+					_mm_storeu_si128((__m128i *) (Depth + x), z);
+			}
+		#else
+			for (int x = 0; x < SNES_WIDTH; x++)
+			{
+				int	top = -1;
+				uint8	z = 0;
+
+				for (int i = 0; i < n; i++)
+				{
+					if (GFX.Layer[layers[i]].Depth[Index + x] > z)
+					{
+						z = GFX.Layer[layers[i]].Depth[Index + x];
+						top = layers[i];
+					}
+				}
+
+				if (top >= 0)
+				{
+					Screen[x] = GFX.Layer[top].Colour[Index + x];
+					Math[x] = GFX.Layer[top].Math[Index + x];
+				}
+				else
+					Math[x] = 0;
+
+				if (Depth)
+					Depth[x] = z;
+			}
+		#endif
+
+			if (Depth)
+				return;
+
+			MathLine<MATH>::Calc(Screen, GFX.SubScreen + Line * GFX.PPL, GFX.SubZBuffer + Line * GFX.PPL, Math, SNES_WIDTH);
+		}
+	};
+
 	// Basic routine to render a chunk of a Mode 7 BG.
 	// Mode 7 has no interlace, so bpstart_t and Pitch are unused.
 	// We get some new parameters, so we can use the same DRAW_TILE to do BG1 or BG2:
@@ -531,6 +734,108 @@ namespace TileImpl {
 		static uint8 DCMODE() { return 0; }
 	};
 
+	// Fetches the Mode 7 map bytes for Count pixels of a line, starting at map position (X, Y) << 8
+	// and stepping by (aa, cc) per pixel. REPEAT is PPU.Mode7Repeat: 0 wraps around the 1024x1024 map,
+	// 3 fills outside it with tile 0 and 1 or 2 leave it transparent, which fetches 0 there.
+	template<int REPEAT>
+	struct Mode7Line
+	{
+		static alwaysinline uint8 Pixel(int X, int Y)
+		{
+			if (REPEAT == 0)
+			{
+				X &= 0x3ff;
+				Y &= 0x3ff;
+			}
+			else
+			if ((X | Y) & ~0x3ff)
+				return (REPEAT == 3) ? Memory.VRAM[1 + ((Y & 7) << 4) + ((X & 7) << 1)] : 0;
+
+			return Memory.VRAM[1 + (Memory.VRAM[((Y & ~7) << 5) + ((X >> 2) & ~1)] << 7) + ((Y & 7) << 4) + ((X & 7) << 1)];
+		}
+
+		static void Fetch(uint8 *Out, int Count, int X, int aa, int Y, int cc)
+		{
+			int	i = 0;
+
+			if (cc == 0 && (REPEAT == 0 || ((Y >> 8) & ~0x3ff) == 0))
+			{
+				// No rotation: the whole line comes from one row of the map,
+				// and neighbouring pixels often share a tile.
+				uint8	*Row = Memory.VRAM + ((((Y >> 8) & 0x3ff) & ~7) << 5);
+				uint8	*Data = Memory.VRAM + 1 + (((Y >> 8) & 7) << 4);
+				uint8	*TileData = Data;
+				int		Column = -1;
+
+				for (; i < Count; i++, X += aa)
+				{
+					int	x = X >> 8;
+
+					if (REPEAT == 0)
+						x &= 0x3ff;
+					else
+					if (x & ~0x3ff)
+					{
+						Out[i] = (REPEAT == 3) ? Data[(x & 7) << 1] : 0;
+						continue;
+					}
+
+					if ((x >> 3) != Column)
+					{
+						Column = x >> 3;
+						TileData = Data + (Row[Column << 1] << 7);
+					}
+
+					Out[i] = TileData[(x & 7) << 1];
+				}
+
+				return;
+			}
+
+		#ifdef HAVE_SSE2
+			// Step four pixels at a time and work out their map and tile offsets together; SSE2 can't gather the bytes.
+			alignas(16) int32	Map[4], Tile[4], Outside[4];
+
+			__m128i	vx = _mm_setr_epi32(X, X + aa, X + aa * 2, X + aa * 3);
+			__m128i	vy = _mm_setr_epi32(Y, Y + cc, Y + cc * 2, Y + cc * 3);
+			const __m128i	stepx = _mm_set1_epi32(aa * 4);
+			const __m128i	stepy = _mm_set1_epi32(cc * 4);
+			const __m128i	seven = _mm_set1_epi32(7);
+
+			for (; i + 4 <= Count; i += 4, vx = _mm_add_epi32(vx, stepx), vy = _mm_add_epi32(vy, stepy))
+			{
+				__m128i	px = _mm_srai_epi32(vx, 8);
+				__m128i	py = _mm_srai_epi32(vy, 8);
+
+				if (REPEAT == 0)
+				{
+					px = _mm_and_si128(px, _mm_set1_epi32(0x3ff));
+					py = _mm_and_si128(py, _mm_set1_epi32(0x3ff));
+				}
+				else
+					_mm_store_si128((__m128i *) Outside, _mm_and_si128(_mm_or_si128(px, py), _mm_set1_epi32(~0x3ff)));
+
+				_mm_store_si128((__m128i *) Map, _mm_add_epi32(_mm_slli_epi32(_mm_andnot_si128(seven, py), 5), _mm_andnot_si128(_mm_set1_epi32(1), _mm_srli_epi32(px, 2))));
+				_mm_store_si128((__m128i *) Tile, _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(py, seven), 4), _mm_slli_epi32(_mm_and_si128(px, seven), 1)));
+
+				for (int j = 0; j < 4; j++)
+				{
+					if (REPEAT != 0 && Outside[j])
+						Out[i + j] = (REPEAT == 3) ? Memory.VRAM[1 + Tile[j]] : 0;
+					else
+						Out[i + j] = Memory.VRAM[1 + (Memory.VRAM[Map[j]] << 7) + Tile[j]];
+				}
+			}
+
+			X += aa * i;
+			Y += cc * i;
+		#endif
+
+			for (; i < Count; i++, X += aa, Y += cc)
+				Out[i] = Pixel(X >> 8, Y >> 8);
+		}
+	};
+
 	template<class PIXEL, class OP>
 	struct DrawTileNormal
 	{
@@ -538,8 +843,6 @@ namespace TileImpl {
 
 		static void Draw(uint32 Left, uint32 Right, int D)
 		{
-			uint8	*VRAM1 = Memory.VRAM + 1;
-
 			if (OP::DCMODE())
 			{
 				GFX.RealScreenColors = DirectColourMaps[0];
@@ -594,42 +897,20 @@ namespace TileImpl {
 				int	CC = l->MatrixC * startx + ((l->MatrixC * xx) & ~63);
 
 				uint8	Pix;
+				uint8	Fetched[SNES_WIDTH];
 
-				if (!PPU.Mode7Repeat)
+				switch (PPU.Mode7Repeat)
 				{
-					for (uint32 x = Left; x < Right; x++, AA += aa, CC += cc)
-					{
-						int	X = ((AA + BB) >> 8) & 0x3ff;
-						int	Y = ((CC + DD) >> 8) & 0x3ff;
-
-						uint8	*TileData = VRAM1 + (Memory.VRAM[((Y & ~7) << 5) + ((X >> 2) & ~1)] << 7);
-						uint8	b = *(TileData + ((Y & 7) << 4) + ((X & 7) << 1));
-
-						Pix = b & OP::MASK; DRAW_PIXEL(x, Pix);
-					}
+					case 0:  Mode7Line<0>::Fetch(Fetched, Right - Left, AA + BB, aa, CC + DD, cc); break;
+					case 3:  Mode7Line<3>::Fetch(Fetched, Right - Left, AA + BB, aa, CC + DD, cc); break;
+					default: Mode7Line<1>::Fetch(Fetched, Right - Left, AA + BB, aa, CC + DD, cc); break;
 				}
-				else
-				{
-					for (uint32 x = Left; x < Right; x++, AA += aa, CC += cc)
-					{
-						int	X = ((AA + BB) >> 8);
-						int	Y = ((CC + DD) >> 8);
-
-						uint8	b;
 
-						if (((X | Y) & ~0x3ff) == 0)
-						{
-							uint8	*TileData = VRAM1 + (Memory.VRAM[((Y & ~7) << 5) + ((X >> 2) & ~1)] << 7);
-							b = *(TileData + ((Y & 7) << 4) + ((X & 7) << 1));
-						}
-						else
-						if (PPU.Mode7Repeat == 3)
-							b = *(VRAM1    + ((Y & 7) << 4) + ((X & 7) << 1));
-						else
-							continue;
+				for (uint32 x = Left; x < Right; x++)
+				{
+					uint8	b = Fetched[x - Left];
 
-						Pix = b & OP::MASK; DRAW_PIXEL(x, Pix);
-					}
+					Pix = b & OP::MASK; DRAW_PIXEL(x, Pix);
 				}
 			}
 		}
@@ -744,8 +1025,9 @@ namespace TileImpl {
 						{
 							for (int32 h = MosaicStart; h < VMosaic; h++)
 							{
+								// Not DRAW_PIXEL(w + h * GFX.PPL), hires pixels would scale the line offset too
 								for (int32 w = x + HMosaic - 1; w >= x; w--)
-									DRAW_PIXEL(w + h * GFX.PPL, (w >= (int32) Left && w < (int32) Right));
+									PIXEL::Draw(w, (w >= (int32) Left && w < (int32) Right), Offset + h * GFX.PPL, OffsetInLine, Pix, OP::Z1(D, b), OP::Z2(D, b));
 							}
 						}
 					}
@@ -778,8 +1060,9 @@ namespace TileImpl {
 						{
 							for (int32 h = MosaicStart; h < VMosaic; h++)
 							{
+								// Not DRAW_PIXEL(w + h * GFX.PPL), hires pixels would scale the line offset too
 								for (int32 w = x + HMosaic - 1; w >= x; w--)
-									DRAW_PIXEL(w + h * GFX.PPL, (w >= (int32) Left && w < (int32) Right));
+									PIXEL::Draw(w, (w >= (int32) Left && w < (int32) Right), Offset + h * GFX.PPL, OffsetInLine, Pix, OP::Z1(D, b), OP::Z2(D, b));
 							}
 						}
 					}